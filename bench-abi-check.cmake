@@ -0,0 +1,35 @@
+# Disassembles bench-abi and checks the claims of its header comment: the producer of variant<int64_t, double> returns
+# in registers without touching memory, while the producer of the non-trivially copyable pack writes through the
+# hidden return pointer in rdi. Run by the bench-abi-registers test, with OBJDUMP and BINARY set.
+
+execute_process(COMMAND ${OBJDUMP} -d -C --no-show-raw-insn ${BINARY} OUTPUT_VARIABLE disassembly RESULT_VARIABLE status)
+if (NOT status EQUAL 0)
+  message(FATAL_ERROR "objdump failed on ${BINARY}")
+endif()
+
+function(function_body header out)
+  string(FIND "${disassembly}" "${header}>:\n" start)
+  if (start EQUAL -1)
+    message(FATAL_ERROR "no function '${header}' in ${BINARY}")
+  endif()
+  string(SUBSTRING "${disassembly}" ${start} -1 body)
+  string(FIND "${body}" "\n\n" end)
+  string(SUBSTRING "${body}" 0 ${end} body)
+  set(${out} "${body}" PARENT_SCOPE)
+endfunction()
+
+function_body("(anonymous namespace)::produce<variant<long, double> >(long)" small)
+string(REPLACE "\n" ";" lines "${small}")
+foreach (line IN LISTS lines)
+  if (line MATCHES "\\(%" AND NOT line MATCHES "\tnop")
+    message(FATAL_ERROR "variant<int64_t, double> is returned through memory:\n${small}")
+  endif()
+endforeach()
+if (NOT small MATCHES "\tret")
+  message(FATAL_ERROR "unexpected producer of variant<int64_t, double>:\n${small}")
+endif()
+
+function_body("(anonymous namespace)::produce_mixed(long)" mixed)
+if (NOT mixed MATCHES "\\(%rdi\\)")
+  message(FATAL_ERROR "the mixed pack is expected to be returned through rdi, the check is not reliable:\n${mixed}")
+endif()
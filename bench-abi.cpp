@@ -0,0 +1,88 @@
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <variant>
+
+#include "bench-perf.h"
+#include "variant.h"
+#include <benchmark/benchmark.h>
+
+// Variants of trivially copyable alternatives that fit in two registers are returned in rax:rdx and passed in
+// registers: the local variant's producer has no memory operand at all, while the mixed pack is written through the
+// hidden return pointer in rdi. The bench-abi-registers test (bench-abi-check.cmake) asserts both on the disassembly.
+// Built with USE_PERF_COUNTERS=ON, each round trip also reports hardware counters per iteration.
+
+namespace {
+using small_t = variant<int64_t, double>;
+using small_std_t = std::variant<int64_t, double>;
+using mixed_t = variant<int64_t, std::string>;
+
+static_assert(std::is_trivially_copyable_v<small_t> && sizeof(small_t) <= 2 * sizeof(void*));
+static_assert(!std::is_trivially_copyable_v<mixed_t>);
+
+template <typename V>
+[[gnu::noinline]] V produce(int64_t i) {
+  if (i & 1) {
+    return V(in_place_index<1>, double(i));
+  }
+  return V(in_place_index<0>, i);
+}
+
+template <typename V>
+[[gnu::noinline]] int64_t consume(V v) {
+  return v.index() == 0 ? *get_if<0>(&v) : 1;
+}
+
+[[gnu::noinline]] small_std_t produce_std(int64_t i) {
+  if (i & 1) {
+    return small_std_t(std::in_place_index<1>, double(i));
+  }
+  return small_std_t(std::in_place_index<0>, i);
+}
+
+[[gnu::noinline]] int64_t consume_std(small_std_t v) {
+  return v.index() == 0 ? *std::get_if<0>(&v) : 1;
+}
+
+void BM_round_trip(benchmark::State& state) {
+  int64_t i = 0;
+  int64_t sum = 0;
+  perf_scope perf(state);
+  for (auto _ : state) {
+    sum += consume(produce<small_t>(i++));
+  }
+  benchmark::DoNotOptimize(sum);
+}
+
+void BM_round_trip_std(benchmark::State& state) {
+  int64_t i = 0;
+  int64_t sum = 0;
+  perf_scope perf(state);
+  for (auto _ : state) {
+    sum += consume_std(produce_std(i++));
+  }
+  benchmark::DoNotOptimize(sum);
+}
+
+[[gnu::noinline]] mixed_t produce_mixed(int64_t i) {
+  return mixed_t(i);
+}
+
+[[gnu::noinline]] int64_t consume_mixed(mixed_t v) {
+  return v.index() == 0 ? *get_if<0>(&v) : 1;
+}
+
+void BM_round_trip_mixed(benchmark::State& state) {
+  int64_t i = 0;
+  int64_t sum = 0;
+  perf_scope perf(state);
+  for (auto _ : state) {
+    sum += consume_mixed(produce_mixed(i++));
+  }
+  benchmark::DoNotOptimize(sum);
+}
+} // namespace
+
+BENCHMARK(BM_round_trip);
+BENCHMARK(BM_round_trip_std);
+BENCHMARK(BM_round_trip_mixed);
@@ -0,0 +1,126 @@
+#include <cstdint>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "bench-perf.h"
+#include "variant.h"
+#include <benchmark/benchmark.h>
+
+// Reallocation, insert and erase move elements only when the variant's move constructor is noexcept, so a wrong
+// noexcept specification shows up here as copies of every element. Built with USE_PERF_COUNTERS=ON, each benchmark
+// also reports hardware counters per iteration.
+
+namespace {
+struct local_policy {
+  template <typename... Types>
+  using variant_t = ::variant<Types...>;
+};
+
+struct std_policy {
+  template <typename... Types>
+  using variant_t = std::variant<Types...>;
+};
+
+// Trivially movable, but copying it is expensive; the variant holding it must still be moved on reallocation.
+struct heavy_copy {
+  heavy_copy() = default;
+  heavy_copy(const heavy_copy& other) : payload(other.payload) {
+    for (int i = 0; i < 64; ++i) {
+      benchmark::DoNotOptimize(payload);
+    }
+  }
+  heavy_copy(heavy_copy&&) noexcept = default;
+  heavy_copy& operator=(const heavy_copy&) = default;
+  heavy_copy& operator=(heavy_copy&&) noexcept = default;
+
+  uint64_t payload = 0;
+};
+
+template <typename Policy>
+using trivial_t = typename Policy::template variant_t<int64_t, double>;
+
+template <typename Policy>
+using string_t = typename Policy::template variant_t<int64_t, std::string>;
+
+template <typename Policy>
+using heavy_t = typename Policy::template variant_t<int64_t, heavy_copy>;
+
+template <typename V>
+V make(size_t i) {
+  if (i % 2 == 0) {
+    return V(int64_t(i));
+  }
+  if constexpr (std::is_constructible_v<V, std::string>) {
+    return V(std::string(32, 'x'));
+  } else if constexpr (std::is_constructible_v<V, heavy_copy>) {
+    return V(heavy_copy{});
+  } else {
+    return V(double(i));
+  }
+}
+
+template <typename V>
+void BM_growth(benchmark::State& state) {
+  const auto count = static_cast<size_t>(state.range(0));
+  perf_scope perf(state);
+  for (auto _ : state) {
+    std::vector<V> values;
+    for (size_t i = 0; i < count; ++i) {
+      values.push_back(make<V>(i));
+    }
+    benchmark::DoNotOptimize(values.data());
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * count));
+}
+
+template <typename V>
+void BM_insert_front(benchmark::State& state) {
+  const auto count = static_cast<size_t>(state.range(0));
+  std::vector<V> base;
+  for (size_t i = 0; i < count; ++i) {
+    base.push_back(make<V>(i));
+  }
+  base.reserve(count + 1);
+  perf_scope perf(state);
+  for (auto _ : state) {
+    base.insert(base.begin(), make<V>(1));
+    base.erase(base.begin());
+    benchmark::DoNotOptimize(base.data());
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * count * 2));
+}
+
+template <typename V>
+void BM_erase_every_other(benchmark::State& state) {
+  const auto count = static_cast<size_t>(state.range(0));
+  std::vector<V> base;
+  for (size_t i = 0; i < count; ++i) {
+    base.push_back(make<V>(i));
+  }
+  perf_scope perf(state);
+  for (auto _ : state) {
+    state.PauseTiming();
+    perf.pause();
+    std::vector<V> values = base;
+    perf.resume();
+    state.ResumeTiming();
+    size_t i = 0;
+    std::erase_if(values, [&i](const V&) { return i++ % 2 == 0; });
+    benchmark::DoNotOptimize(values.data());
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * count));
+}
+
+#define VARIANT_CONTAINER_BENCHMARKS(type)                                                                             \
+  BENCHMARK_TEMPLATE(BM_growth, type<local_policy>)->Arg(1 << 16);                                                     \
+  BENCHMARK_TEMPLATE(BM_growth, type<std_policy>)->Arg(1 << 16);                                                       \
+  BENCHMARK_TEMPLATE(BM_insert_front, type<local_policy>)->Arg(1 << 12);                                               \
+  BENCHMARK_TEMPLATE(BM_insert_front, type<std_policy>)->Arg(1 << 12);                                                 \
+  BENCHMARK_TEMPLATE(BM_erase_every_other, type<local_policy>)->Arg(1 << 16);                                          \
+  BENCHMARK_TEMPLATE(BM_erase_every_other, type<std_policy>)->Arg(1 << 16);
+
+VARIANT_CONTAINER_BENCHMARKS(trivial_t)
+VARIANT_CONTAINER_BENCHMARKS(string_t)
+VARIANT_CONTAINER_BENCHMARKS(heavy_t)
+} // namespace
@@ -0,0 +1,108 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "variant.h"
+#include "vexpected.h"
+#include <benchmark/benchmark.h>
+
+namespace {
+enum class parse_error : uint8_t { empty, bad_digit, overflow };
+
+constexpr size_t inputs = 1 << 12;
+
+std::vector<std::string> make_inputs() {
+  std::vector<std::string> result;
+  for (size_t i = 0; i < inputs; ++i) {
+    result.push_back(i % 16 == 0 ? std::string("12x4") : std::to_string(i * 7919 % 100000));
+  }
+  return result;
+}
+
+[[gnu::noinline]] expected<uint32_t, parse_error> parse_expected(const std::string& s) {
+  if (s.empty()) {
+    return unexpected(parse_error::empty);
+  }
+  uint32_t value = 0;
+  for (char c : s) {
+    if (c < '0' || c > '9') {
+      return unexpected(parse_error::bad_digit);
+    }
+    value = value * 10 + uint32_t(c - '0');
+  }
+  return value;
+}
+
+[[gnu::noinline]] variant<uint32_t, parse_error> parse_variant(const std::string& s) {
+  if (s.empty()) {
+    return parse_error::empty;
+  }
+  uint32_t value = 0;
+  for (char c : s) {
+    if (c < '0' || c > '9') {
+      return parse_error::bad_digit;
+    }
+    value = value * 10 + uint32_t(c - '0');
+  }
+  return value;
+}
+
+expected<uint32_t, parse_error> checked_double(uint32_t v) {
+  if (v > UINT32_MAX / 2) {
+    return unexpected(parse_error::overflow);
+  }
+  return v * 2;
+}
+
+void BM_expected(benchmark::State& state) {
+  auto data = make_inputs();
+  uint64_t sum = 0;
+  for (auto _ : state) {
+    for (const auto& s : data) {
+      sum += parse_expected(s).and_then(checked_double).transform([](uint32_t v) { return v + 1; }).value_or(0);
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.counters["checksum"] = static_cast<double>(sum);
+  state.counters["parses_per_second"] =
+      benchmark::Counter(static_cast<double>(inputs), benchmark::Counter::kIsIterationInvariantRate);
+}
+
+// The pattern expected replaces: a variant<T, Error> result unpacked with visit.
+void BM_variant_result(benchmark::State& state) {
+  auto data = make_inputs();
+  uint64_t sum = 0;
+  for (auto _ : state) {
+    for (const auto& s : data) {
+      variant<uint32_t, parse_error> doubled = visit(
+          [](auto v) -> variant<uint32_t, parse_error> {
+            if constexpr (std::is_same_v<decltype(v), uint32_t>) {
+              if (v > UINT32_MAX / 2) {
+                return parse_error::overflow;
+              }
+              return v * 2;
+            } else {
+              return v;
+            }
+          },
+          parse_variant(s));
+      sum += visit(
+          [](auto v) -> uint32_t {
+            if constexpr (std::is_same_v<decltype(v), uint32_t>) {
+              return v + 1;
+            } else {
+              return 0;
+            }
+          },
+          doubled);
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.counters["checksum"] = static_cast<double>(sum);
+  state.counters["parses_per_second"] =
+      benchmark::Counter(static_cast<double>(inputs), benchmark::Counter::kIsIterationInvariantRate);
+}
+} // namespace
+
+BENCHMARK(BM_expected);
+BENCHMARK(BM_variant_result);
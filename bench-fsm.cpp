@@ -0,0 +1,179 @@
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <vector>
+
+#include "variant.h"
+#include "vfsm.h"
+#include <benchmark/benchmark.h>
+
+namespace {
+struct idle {};
+struct resolving {
+  uint32_t host;
+};
+struct connecting {
+  uint32_t address;
+  uint32_t attempts;
+};
+struct established {
+  uint64_t bytes;
+  uint64_t packets;
+};
+struct closing {
+  uint64_t bytes;
+};
+
+struct connect_request {
+  uint32_t host;
+};
+struct resolved {
+  uint32_t address;
+};
+struct connected {};
+struct timeout {};
+struct payload {
+  uint32_t size;
+};
+struct ack {};
+struct close_request {};
+struct closed {};
+
+using states = variant<idle, resolving, connecting, established, closing>;
+using events = variant<connect_request, resolved, connected, timeout, payload, ack, close_request, closed>;
+
+struct totals {
+  uint64_t bytes = 0;
+  uint64_t connections = 0;
+};
+
+struct transitions {
+  resolving operator()(idle&, const connect_request& e) const {
+    return {e.host};
+  }
+  enter<connecting, uint32_t, uint32_t> operator()(resolving&, const resolved& e) const {
+    return enter_state<connecting>(e.address, 1u);
+  }
+  idle operator()(resolving&, const timeout&) const {
+    return {};
+  }
+  void operator()(connecting& s, const timeout&) const {
+    ++s.attempts;
+  }
+  established operator()(connecting&, const connected&) const {
+    ++stats->connections;
+    return {0, 0};
+  }
+  void operator()(established& s, const payload& e) const {
+    s.bytes += e.size;
+    ++s.packets;
+  }
+  void operator()(established& s, const ack&) const {
+    s.packets = 0;
+  }
+  closing operator()(established& s, const close_request&) const {
+    return {s.bytes};
+  }
+  idle operator()(closing& s, const closed&) const {
+    stats->bytes += s.bytes;
+    return {};
+  }
+
+  totals* stats;
+};
+
+// Connection lifecycles with a long run of payload and ack events in the established state, interleaved with events
+// that have no transition in the current state.
+std::vector<events> make_events(size_t count) {
+  std::mt19937 rng(42);
+  std::vector<events> result;
+  result.reserve(count);
+  while (result.size() < count) {
+    result.emplace_back(connect_request{static_cast<uint32_t>(rng())});
+    result.emplace_back(resolved{static_cast<uint32_t>(rng())});
+    for (uint32_t i = rng() % 3; i > 0; --i) {
+      result.emplace_back(timeout{});
+    }
+    result.emplace_back(connected{});
+    for (uint32_t i = 64 + rng() % 64; i > 0; --i) {
+      switch (rng() % 8) {
+      case 0:
+        result.emplace_back(ack{});
+        break;
+      case 1:
+        result.emplace_back(timeout{});
+        break;
+      default:
+        result.emplace_back(payload{static_cast<uint32_t>(rng() % 1500)});
+        break;
+      }
+    }
+    result.emplace_back(close_request{});
+    result.emplace_back(closed{});
+  }
+  return result;
+}
+
+const std::vector<events>& event_log() {
+  static const std::vector<events> log = make_events(1 << 16);
+  return log;
+}
+
+void report(benchmark::State& state, const totals& stats) {
+  state.counters["bytes"] = static_cast<double>(stats.bytes);
+  state.counters["events_per_second"] =
+      benchmark::Counter(static_cast<double>(event_log().size()), benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void BM_state_machine(benchmark::State& state) {
+  const auto& log = event_log();
+  totals stats;
+  for (auto _ : state) {
+    stats = {};
+    auto machine = make_state_machine<states, events>(transitions{&stats});
+    for (const auto& e : log) {
+      machine.dispatch(e);
+    }
+    benchmark::DoNotOptimize(machine);
+  }
+  report(state, stats);
+}
+
+// The pattern the state machine replaces: visiting both variants and assigning the next state through a temporary
+// variant.
+void BM_two_variant_visit(benchmark::State& state) {
+  const auto& log = event_log();
+  totals stats;
+  for (auto _ : state) {
+    stats = {};
+    transitions handlers{&stats};
+    states current;
+    for (const auto& e : log) {
+      auto next = visit(
+          [&handlers]<typename State, typename Event>(State& s, const Event& event) -> std::optional<states> {
+            if constexpr (std::is_invocable_v<transitions&, State&, const Event&>) {
+              using result_t = std::invoke_result_t<transitions&, State&, const Event&>;
+              if constexpr (std::is_void_v<result_t>) {
+                handlers(s, event);
+              } else if constexpr (std::is_same_v<result_t, enter<connecting, uint32_t, uint32_t>>) {
+                auto next = handlers(s, event);
+                return states(connecting{get<0>(next.args), get<1>(next.args)});
+              } else {
+                return states(handlers(s, event));
+              }
+            }
+            return std::nullopt;
+          },
+          current, e);
+      if (next) {
+        current = std::move(*next);
+      }
+    }
+    benchmark::DoNotOptimize(current);
+  }
+  report(state, stats);
+}
+} // namespace
+
+BENCHMARK(BM_state_machine);
+BENCHMARK(BM_two_variant_visit);
@@ -0,0 +1,85 @@
+#include <cstdint>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "variant.h"
+#include "vhash_map.h"
+#include <benchmark/benchmark.h>
+
+namespace {
+using symbol = variant<int64_t, std::string>;
+
+struct symbol_hash {
+  size_t operator()(const symbol& key) const {
+    return visit([](const auto& value) { return std::hash<std::decay_t<decltype(value)>>{}(value); }, key);
+  }
+};
+
+struct symbol_equal {
+  bool operator()(const symbol& lhs, const symbol& rhs) const {
+    return lhs == rhs;
+  }
+};
+
+struct corpus {
+  std::vector<int64_t> numbers;
+  std::vector<std::string> names;
+};
+
+// Half of the probes miss, and names share long prefixes as identifiers in a symbol table tend to.
+const corpus& keys(size_t count) {
+  static std::unordered_map<size_t, corpus> cache;
+  corpus& c = cache[count];
+  if (c.numbers.empty()) {
+    std::mt19937_64 rng(7);
+    for (size_t i = 0; i < count; ++i) {
+      c.numbers.push_back(static_cast<int64_t>(rng() >> 1));
+      c.names.push_back("module::symbol_" + std::to_string(rng() % (count * 4)));
+    }
+  }
+  return c;
+}
+
+void BM_variant_hash_map(benchmark::State& state) {
+  const corpus& c = keys(static_cast<size_t>(state.range(0)));
+  variant_hash_map<symbol, size_t> map;
+  for (size_t i = 0; i < c.numbers.size(); i += 2) {
+    map.try_emplace(c.numbers[i], i);
+    map.try_emplace(c.names[i], i);
+  }
+  for (auto _ : state) {
+    size_t found = 0;
+    for (size_t i = 0; i < c.numbers.size(); ++i) {
+      found += map.contains(c.numbers[i]);
+      found += map.contains(c.names[i]);
+    }
+    benchmark::DoNotOptimize(found);
+  }
+  state.counters["lookups_per_second"] = benchmark::Counter(static_cast<double>(2 * c.numbers.size()),
+                                                            benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void BM_unordered_map(benchmark::State& state) {
+  const corpus& c = keys(static_cast<size_t>(state.range(0)));
+  std::unordered_map<symbol, size_t, symbol_hash, symbol_equal> map;
+  for (size_t i = 0; i < c.numbers.size(); i += 2) {
+    map.try_emplace(c.numbers[i], i);
+    map.try_emplace(c.names[i], i);
+  }
+  for (auto _ : state) {
+    size_t found = 0;
+    for (size_t i = 0; i < c.numbers.size(); ++i) {
+      found += map.contains(symbol(c.numbers[i]));
+      found += map.contains(symbol(c.names[i]));
+    }
+    benchmark::DoNotOptimize(found);
+  }
+  state.counters["lookups_per_second"] = benchmark::Counter(static_cast<double>(2 * c.numbers.size()),
+                                                            benchmark::Counter::kIsIterationInvariantRate);
+}
+} // namespace
+
+BENCHMARK(BM_variant_hash_map)->Arg(1 << 10)->Arg(1 << 16)->Arg(1 << 20);
+BENCHMARK(BM_unordered_map)->Arg(1 << 10)->Arg(1 << 16)->Arg(1 << 20);
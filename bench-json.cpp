@@ -0,0 +1,663 @@
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "variant.h"
+#include <benchmark/benchmark.h>
+
+namespace {
+struct null_t {
+  friend constexpr bool operator==(null_t, null_t) noexcept {
+    return true;
+  }
+};
+
+struct json_value;
+struct json_member;
+
+struct json_array {
+  json_value* data;
+  size_t size;
+};
+
+struct json_object {
+  json_member* data;
+  size_t size;
+};
+
+using json_variant = variant<null_t, bool, int64_t, double, std::string_view, json_array, json_object>;
+
+struct json_value {
+  json_variant v;
+};
+
+struct json_member {
+  std::string_view key;
+  json_value value;
+};
+
+class json_arena {
+public:
+  explicit json_arena(size_t block_size = size_t(1) << 20) : block_size_(block_size) {}
+
+  template <typename T>
+  T* allocate(size_t count) {
+    static_assert(std::is_trivially_destructible_v<T>);
+    size_t bytes = count * sizeof(T);
+    size_t offset = (used_ + alignof(T) - 1) & ~(alignof(T) - 1);
+    if (blocks_.empty() || offset + bytes > capacity_) {
+      grow(bytes + alignof(T));
+      offset = (used_ + alignof(T) - 1) & ~(alignof(T) - 1);
+    }
+    used_ = offset + bytes;
+    return reinterpret_cast<T*>(blocks_[current_].get() + offset);
+  }
+
+  void reset() noexcept {
+    current_ = 0;
+    used_ = 0;
+    capacity_ = blocks_.empty() ? 0 : sizes_[0];
+  }
+
+private:
+  void grow(size_t at_least) {
+    ++current_;
+    if (blocks_.empty() || current_ >= blocks_.size() || sizes_[current_] < at_least) {
+      size_t size = std::max(block_size_, at_least);
+      current_ = blocks_.size();
+      blocks_.push_back(std::make_unique<std::byte[]>(size));
+      sizes_.push_back(size);
+    }
+    used_ = 0;
+    capacity_ = sizes_[current_];
+  }
+
+  size_t block_size_;
+  std::vector<std::unique_ptr<std::byte[]>> blocks_;
+  std::vector<size_t> sizes_;
+  size_t current_ = 0;
+  size_t used_ = 0;
+  size_t capacity_ = 0;
+};
+
+// Children of the arrays and objects being parsed are collected on stacks shared by all nesting levels, which keep
+// their capacity across parse() calls, and are copied into the arena once the container is closed.
+class json_parser {
+public:
+  explicit json_parser(json_arena& arena) : arena_(arena) {}
+
+  json_value parse(std::string_view text) {
+    text_ = text;
+    pos_ = 0;
+    values_.clear();
+    members_.clear();
+    json_value result = value();
+    skip_ws();
+    if (pos_ != text_.size()) {
+      fail("trailing characters");
+    }
+    return result;
+  }
+
+private:
+  [[noreturn]] void fail(const char* what) const {
+    throw std::runtime_error(std::string("json: ") + what + " at " + std::to_string(pos_));
+  }
+
+  void skip_ws() noexcept {
+    while (pos_ < text_.size() &&
+           (text_[pos_] == ' ' || text_[pos_] == '\n' || text_[pos_] == '\r' || text_[pos_] == '\t')) {
+      ++pos_;
+    }
+  }
+
+  void expect(std::string_view literal) {
+    if (text_.substr(pos_, literal.size()) != literal) {
+      fail("unexpected literal");
+    }
+    pos_ += literal.size();
+  }
+
+  json_value value() {
+    skip_ws();
+    if (pos_ == text_.size()) {
+      fail("unexpected end");
+    }
+    switch (text_[pos_]) {
+    case '{':
+      return {object()};
+    case '[':
+      return {array()};
+    case '"':
+      return {string()};
+    case 't':
+      expect("true");
+      return {true};
+    case 'f':
+      expect("false");
+      return {false};
+    case 'n':
+      expect("null");
+      return {null_t{}};
+    default:
+      return number();
+    }
+  }
+
+  json_value number() {
+    const char* first = text_.data() + pos_;
+    const char* last = text_.data() + text_.size();
+    const char* end = first + (*first == '-' ? 1 : 0);
+    bool integral = true;
+    while (end != last && ((*end >= '0' && *end <= '9') || *end == '.' || *end == 'e' || *end == 'E' ||
+                           ((*end == '+' || *end == '-') && (end[-1] == 'e' || end[-1] == 'E')))) {
+      integral = integral && *end >= '0' && *end <= '9';
+      ++end;
+    }
+    if (integral) {
+      int64_t value;
+      auto [ptr, ec] = std::from_chars(first, end, value);
+      if (ec == std::errc() && ptr == end) {
+        pos_ += end - first;
+        return {value};
+      }
+    }
+    double value;
+    auto [ptr, ec] = std::from_chars(first, end, value);
+    if (ec != std::errc() || ptr != end || ptr == first) {
+      fail("bad number");
+    }
+    pos_ += end - first;
+    return {value};
+  }
+
+  static bool is_control(char c) noexcept {
+    return static_cast<unsigned char>(c) < 0x20;
+  }
+
+  std::string_view string() {
+    ++pos_;
+    size_t start = pos_;
+    while (pos_ < text_.size() && text_[pos_] != '"' && text_[pos_] != '\\' && !is_control(text_[pos_])) {
+      ++pos_;
+    }
+    if (pos_ == text_.size()) {
+      fail("unterminated string");
+    }
+    if (text_[pos_] == '"') {
+      return text_.substr(start, pos_++ - start);
+    }
+    scratch_.assign(text_.substr(start, pos_ - start));
+    while (pos_ < text_.size() && text_[pos_] != '"') {
+      char c = text_[pos_++];
+      if (is_control(c)) {
+        fail("control character in string");
+      }
+      if (c != '\\') {
+        scratch_.push_back(c);
+        continue;
+      }
+      if (pos_ == text_.size()) {
+        fail("unterminated escape");
+      }
+      switch (char e = text_[pos_++]) {
+      case 'n':
+        scratch_.push_back('\n');
+        break;
+      case 't':
+        scratch_.push_back('\t');
+        break;
+      case 'r':
+        scratch_.push_back('\r');
+        break;
+      case 'b':
+        scratch_.push_back('\b');
+        break;
+      case 'f':
+        scratch_.push_back('\f');
+        break;
+      case 'u':
+        unicode_escape();
+        break;
+      case '"':
+      case '\\':
+      case '/':
+        scratch_.push_back(e);
+        break;
+      default:
+        fail("bad escape");
+      }
+    }
+    if (pos_ == text_.size()) {
+      fail("unterminated string");
+    }
+    ++pos_;
+    char* data = arena_.allocate<char>(scratch_.size());
+    std::memcpy(data, scratch_.data(), scratch_.size());
+    return {data, scratch_.size()};
+  }
+
+  unsigned hex4() {
+    if (pos_ + 4 > text_.size()) {
+      fail("bad unicode escape");
+    }
+    unsigned code = 0;
+    auto [ptr, ec] = std::from_chars(text_.data() + pos_, text_.data() + pos_ + 4, code, 16);
+    if (ec != std::errc() || ptr != text_.data() + pos_ + 4) {
+      fail("bad unicode escape");
+    }
+    pos_ += 4;
+    return code;
+  }
+
+  void unicode_escape() {
+    unsigned code = hex4();
+    if (code >= 0xDC00 && code < 0xE000) {
+      fail("unpaired low surrogate");
+    }
+    if (code >= 0xD800 && code < 0xDC00) {
+      if (text_.substr(pos_, 2) != "\\u") {
+        fail("unpaired high surrogate");
+      }
+      pos_ += 2;
+      unsigned low = hex4();
+      if (low < 0xDC00 || low >= 0xE000) {
+        fail("unpaired high surrogate");
+      }
+      code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+    }
+    if (code < 0x80) {
+      scratch_.push_back(static_cast<char>(code));
+    } else if (code < 0x800) {
+      scratch_.push_back(static_cast<char>(0xC0 | (code >> 6)));
+      scratch_.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else if (code < 0x10000) {
+      scratch_.push_back(static_cast<char>(0xE0 | (code >> 12)));
+      scratch_.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+      scratch_.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else {
+      scratch_.push_back(static_cast<char>(0xF0 | (code >> 18)));
+      scratch_.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+      scratch_.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+      scratch_.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    }
+  }
+
+  json_array array() {
+    ++pos_;
+    size_t first = values_.size();
+    skip_ws();
+    if (pos_ < text_.size() && text_[pos_] == ']') {
+      ++pos_;
+      return {nullptr, 0};
+    }
+    while (true) {
+      json_value item = value();
+      values_.push_back(item);
+      skip_ws();
+      if (pos_ == text_.size()) {
+        fail("unterminated array");
+      }
+      if (text_[pos_++] == ']') {
+        break;
+      }
+      if (text_[pos_ - 1] != ',') {
+        fail("expected ','");
+      }
+    }
+    size_t size = values_.size() - first;
+    auto* data = arena_.allocate<json_value>(size);
+    std::uninitialized_copy(values_.begin() + first, values_.end(), data);
+    values_.resize(first);
+    return {data, size};
+  }
+
+  json_object object() {
+    ++pos_;
+    size_t first = members_.size();
+    skip_ws();
+    if (pos_ < text_.size() && text_[pos_] == '}') {
+      ++pos_;
+      return {nullptr, 0};
+    }
+    while (true) {
+      skip_ws();
+      if (pos_ == text_.size() || text_[pos_] != '"') {
+        fail("expected key");
+      }
+      std::string_view key = string();
+      skip_ws();
+      if (pos_ == text_.size() || text_[pos_++] != ':') {
+        fail("expected ':'");
+      }
+      json_member member{key, value()};
+      members_.push_back(member);
+      skip_ws();
+      if (pos_ == text_.size()) {
+        fail("unterminated object");
+      }
+      if (text_[pos_++] == '}') {
+        break;
+      }
+      if (text_[pos_ - 1] != ',') {
+        fail("expected ','");
+      }
+    }
+    size_t size = members_.size() - first;
+    auto* data = arena_.allocate<json_member>(size);
+    std::uninitialized_copy(members_.begin() + first, members_.end(), data);
+    members_.resize(first);
+    return {data, size};
+  }
+
+  std::string_view text_;
+  json_arena& arena_;
+  std::string scratch_;
+  std::vector<json_value> values_;
+  std::vector<json_member> members_;
+  size_t pos_ = 0;
+};
+
+void serialize_string(std::string_view s, std::string& out) {
+  out.push_back('"');
+  for (char c : s) {
+    switch (c) {
+    case '"':
+      out.append("\\\"");
+      break;
+    case '\\':
+      out.append("\\\\");
+      break;
+    case '\b':
+      out.append("\\b");
+      break;
+    case '\f':
+      out.append("\\f");
+      break;
+    case '\n':
+      out.append("\\n");
+      break;
+    case '\r':
+      out.append("\\r");
+      break;
+    case '\t':
+      out.append("\\t");
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        static constexpr char hex[] = "0123456789abcdef";
+        out.append("\\u00");
+        out.push_back(hex[static_cast<unsigned char>(c) >> 4]);
+        out.push_back(hex[c & 0xF]);
+      } else {
+        out.push_back(c);
+      }
+    }
+  }
+  out.push_back('"');
+}
+
+void serialize(const json_value& value, std::string& out) {
+  visit(
+      [&out](const auto& x) {
+        using T = std::decay_t<decltype(x)>;
+        if constexpr (std::is_same_v<T, null_t>) {
+          out.append("null");
+        } else if constexpr (std::is_same_v<T, bool>) {
+          out.append(x ? "true" : "false");
+        } else if constexpr (std::is_same_v<T, int64_t> || std::is_same_v<T, double>) {
+          char buffer[32];
+          auto [ptr, ec] = std::to_chars(buffer, buffer + sizeof(buffer), x);
+          out.append(buffer, ptr);
+        } else if constexpr (std::is_same_v<T, std::string_view>) {
+          serialize_string(x, out);
+        } else if constexpr (std::is_same_v<T, json_array>) {
+          out.push_back('[');
+          for (size_t i = 0; i < x.size; ++i) {
+            if (i != 0) {
+              out.push_back(',');
+            }
+            serialize(x.data[i], out);
+          }
+          out.push_back(']');
+        } else {
+          out.push_back('{');
+          for (size_t i = 0; i < x.size; ++i) {
+            if (i != 0) {
+              out.push_back(',');
+            }
+            serialize_string(x.data[i].key, out);
+            out.push_back(':');
+            serialize(x.data[i].value, out);
+          }
+          out.push_back('}');
+        }
+      },
+      value.v);
+}
+
+struct json_stats {
+  size_t nodes = 0;
+  size_t string_bytes = 0;
+  double number_sum = 0;
+};
+
+void traverse(const json_value& value, json_stats& stats) {
+  ++stats.nodes;
+  visit(
+      [&stats](const auto& x) {
+        using T = std::decay_t<decltype(x)>;
+        if constexpr (std::is_same_v<T, int64_t> || std::is_same_v<T, double>) {
+          stats.number_sum += static_cast<double>(x);
+        } else if constexpr (std::is_same_v<T, std::string_view>) {
+          stats.string_bytes += x.size();
+        } else if constexpr (std::is_same_v<T, json_array>) {
+          for (size_t i = 0; i < x.size; ++i) {
+            traverse(x.data[i], stats);
+          }
+        } else if constexpr (std::is_same_v<T, json_object>) {
+          for (size_t i = 0; i < x.size; ++i) {
+            stats.string_bytes += x.data[i].key.size();
+            traverse(x.data[i].value, stats);
+          }
+        }
+      },
+      value.v);
+}
+
+class corpus_generator {
+public:
+  explicit corpus_generator(uint32_t seed) : rng_(seed) {}
+
+  std::string twitter_like(size_t statuses) {
+    std::string out = "{\"statuses\":[";
+    for (size_t i = 0; i < statuses; ++i) {
+      if (i != 0) {
+        out.push_back(',');
+      }
+      out += "{\"id\":";
+      out += std::to_string(rng_() % 1000000000000ULL);
+      out += ",\"text\":";
+      serialize_string(word_salad(5 + rng_() % 20), out);
+      out += ",\"truncated\":";
+      out += rng_() % 2 ? "true" : "false";
+      out += ",\"in_reply_to\":null,\"user\":{\"id\":";
+      out += std::to_string(rng_() % 100000);
+      out += ",\"name\":";
+      serialize_string(word_salad(2), out);
+      out += ",\"followers\":";
+      out += std::to_string(rng_() % 50000);
+      out += ",\"verified\":false,\"description\":\"caf\\u00e9 \\ud83d\\ude00 \\\"quoted\\\"\\r\\n\\u0001text\"}";
+      out += ",\"retweets\":";
+      out += std::to_string(rng_() % 1000);
+      out += ",\"hashtags\":[";
+      for (size_t j = 0, n = rng_() % 4; j < n; ++j) {
+        if (j != 0) {
+          out.push_back(',');
+        }
+        serialize_string(word(), out);
+      }
+      out += "]}";
+    }
+    out += "]}";
+    return out;
+  }
+
+  std::string canada_like(size_t polygons) {
+    std::uniform_real_distribution<double> coord(-180.0, 180.0);
+    std::string out = "{\"type\":\"FeatureCollection\",\"features\":[{\"type\":\"Feature\",\"geometry\":"
+                      "{\"type\":\"Polygon\",\"coordinates\":[";
+    for (size_t i = 0; i < polygons; ++i) {
+      out += i != 0 ? ",[" : "[";
+      for (size_t j = 0, n = 16 + rng_() % 64; j < n; ++j) {
+        char buffer[64];
+        auto x = std::to_chars(buffer, buffer + sizeof(buffer), coord(rng_)).ptr;
+        *x++ = ',';
+        x = std::to_chars(x, buffer + sizeof(buffer), coord(rng_)).ptr;
+        out += j != 0 ? ",[" : "[";
+        out.append(buffer, x);
+        out.push_back(']');
+      }
+      out.push_back(']');
+    }
+    out += "]}}]}";
+    return out;
+  }
+
+  std::string citm_like(size_t events) {
+    std::string out = "{\"events\":{";
+    for (size_t i = 0; i < events; ++i) {
+      if (i != 0) {
+        out.push_back(',');
+      }
+      out.push_back('"');
+      out += std::to_string(100000 + i);
+      out += "\":{\"id\":";
+      out += std::to_string(100000 + i);
+      out += ",\"name\":";
+      serialize_string(word_salad(3), out);
+      out += ",\"logo\":null,\"subTopicIds\":[";
+      for (size_t j = 0, n = 1 + rng_() % 6; j < n; ++j) {
+        if (j != 0) {
+          out.push_back(',');
+        }
+        out += std::to_string(337000000 + rng_() % 1000);
+      }
+      out += "],\"price\":";
+      out += std::to_string((rng_() % 10000) / 100.0);
+      out.push_back('}');
+    }
+    out += "}}";
+    return out;
+  }
+
+private:
+  std::string_view word() {
+    static constexpr std::string_view words[] = {"variant", "visit", "alpha", "beta", "gamma", "delta",
+                                                 "lorem",   "ipsum", "json",  "value", "arena", "parse"};
+    return words[rng_() % std::size(words)];
+  }
+
+  std::string word_salad(size_t n) {
+    std::string result;
+    for (size_t i = 0; i < n; ++i) {
+      if (i != 0) {
+        result.push_back(' ');
+      }
+      result += word();
+    }
+    return result;
+  }
+
+  std::mt19937_64 rng_;
+};
+
+const std::string& corpus(int64_t kind) {
+  static const std::string corpora[] = {
+      corpus_generator(1).twitter_like(2000),
+      corpus_generator(2).canada_like(2000),
+      corpus_generator(3).citm_like(5000),
+  };
+  return corpora[kind];
+}
+
+const char* corpus_name(int64_t kind) {
+  static constexpr const char* names[] = {"twitter", "canada", "citm"};
+  return names[kind];
+}
+
+void BM_parse(benchmark::State& state) {
+  const std::string& text = corpus(state.range(0));
+  json_arena arena;
+  json_parser parser(arena);
+  for (auto _ : state) {
+    arena.reset();
+    json_value root = parser.parse(text);
+    benchmark::DoNotOptimize(root);
+  }
+  state.SetLabel(corpus_name(state.range(0)));
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+}
+
+void BM_traverse(benchmark::State& state) {
+  const std::string& text = corpus(state.range(0));
+  json_arena arena;
+  json_value root = json_parser(arena).parse(text);
+  json_stats stats;
+  for (auto _ : state) {
+    stats = {};
+    traverse(root, stats);
+    benchmark::DoNotOptimize(stats);
+  }
+  state.SetLabel(corpus_name(state.range(0)));
+  state.counters["nodes"] = static_cast<double>(stats.nodes);
+  state.counters["nodes_per_second"] =
+      benchmark::Counter(static_cast<double>(stats.nodes), benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void BM_serialize(benchmark::State& state) {
+  const std::string& text = corpus(state.range(0));
+  json_arena arena;
+  json_value root = json_parser(arena).parse(text);
+  std::string out;
+  for (auto _ : state) {
+    out.clear();
+    serialize(root, out);
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetLabel(corpus_name(state.range(0)));
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * out.size()));
+}
+
+void BM_round_trip(benchmark::State& state) {
+  const std::string& text = corpus(state.range(0));
+  json_arena arena;
+  json_parser parser(arena);
+  std::string out;
+  for (auto _ : state) {
+    arena.reset();
+    out.clear();
+    serialize(parser.parse(text), out);
+    benchmark::DoNotOptimize(out.data());
+  }
+  json_arena check_arena;
+  std::string again;
+  serialize(json_parser(check_arena).parse(out), again);
+  if (again != out) {
+    state.SkipWithError("serializer output does not round-trip");
+  }
+  state.SetLabel(corpus_name(state.range(0)));
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+}
+} // namespace
+
+BENCHMARK(BM_parse)->DenseRange(0, 2);
+BENCHMARK(BM_traverse)->DenseRange(0, 2);
+BENCHMARK(BM_serialize)->DenseRange(0, 2);
+BENCHMARK(BM_round_trip)->DenseRange(0, 2);
@@ -0,0 +1,132 @@
+#ifndef VARIANT_BENCH_PERF_H
+#define VARIANT_BENCH_PERF_H
+
+#include <benchmark/benchmark.h>
+
+#if defined(VARIANT_PERF_COUNTERS) && defined(__linux__)
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(VARIANT_PERF_COUNTERS) && defined(__linux__)
+constexpr uint64_t perf_cache_read_miss(uint64_t cache) {
+  return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+#endif
+
+// Hardware counters for the benchmarks, read through perf_event_open when the benchmarks are built with
+// USE_PERF_COUNTERS=ON on Linux. A perf_scope counts user-space events of the calling thread from its construction to
+// its destruction and adds them to the benchmark's counters per iteration, so construct it right before the timing
+// loop. Events the kernel or the hardware refuses (containers, perf_event_paranoid > 2, virtual machines without a
+// PMU) are left out of the report, with one note on stderr; in other builds a perf_scope does nothing. Call pause()
+// and resume() next to state.PauseTiming() and state.ResumeTiming() to leave untimed setup out of the counts too.
+class perf_scope {
+public:
+  explicit perf_scope(benchmark::State& state) : state_(state) {
+#if defined(VARIANT_PERF_COUNTERS) && defined(__linux__)
+    for (size_t i = 0; i < events.size(); ++i) {
+      fds_[i] = open(events[i]);
+    }
+    for (int fd : fds_) {
+      if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+#endif
+  }
+
+  perf_scope(const perf_scope&) = delete;
+  perf_scope& operator=(const perf_scope&) = delete;
+
+  void pause() noexcept {
+#if defined(VARIANT_PERF_COUNTERS) && defined(__linux__)
+    control(PERF_EVENT_IOC_DISABLE);
+#endif
+  }
+
+  void resume() noexcept {
+#if defined(VARIANT_PERF_COUNTERS) && defined(__linux__)
+    control(PERF_EVENT_IOC_ENABLE);
+#endif
+  }
+
+  ~perf_scope() {
+#if defined(VARIANT_PERF_COUNTERS) && defined(__linux__)
+    control(PERF_EVENT_IOC_DISABLE);
+    for (size_t i = 0; i < events.size(); ++i) {
+      if (fds_[i] < 0) {
+        continue;
+      }
+      // Scaled by the share of time the event was scheduled, in case the PMU had to multiplex it with others.
+      uint64_t values[3] = {};
+      if (read(fds_[i], values, sizeof(values)) == sizeof(values) && values[2] != 0) {
+        double count = double(values[0]) * double(values[1]) / double(values[2]);
+        state_.counters[events[i].name] = benchmark::Counter(count, benchmark::Counter::kAvgIterations);
+      }
+      close(fds_[i]);
+    }
+#else
+    static_cast<void>(state_);
+#endif
+  }
+
+private:
+#if defined(VARIANT_PERF_COUNTERS) && defined(__linux__)
+  struct event {
+    const char* name;
+    uint32_t type;
+    uint64_t config;
+  };
+
+  static constexpr std::array<event, 5> events = {{
+      {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+      {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+      {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+      {"l1d_misses", PERF_TYPE_HW_CACHE, perf_cache_read_miss(PERF_COUNT_HW_CACHE_L1D)},
+      {"llc_misses", PERF_TYPE_HW_CACHE, perf_cache_read_miss(PERF_COUNT_HW_CACHE_LL)},
+  }};
+
+  void control(unsigned long request) noexcept {
+    for (int fd : fds_) {
+      if (fd >= 0) {
+        ioctl(fd, request, 0);
+      }
+    }
+  }
+
+  static int open(const event& e) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = e.type;
+    attr.config = e.config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    int fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    if (fd < 0) {
+      static bool noted = false;
+      if (!noted) {
+        noted = true;
+        std::fprintf(stderr, "perf counters: cannot count %s (%s), leaving out what is unavailable\n", e.name,
+                     std::strerror(errno));
+      }
+    }
+    return fd;
+  }
+
+  std::array<int, events.size()> fds_{};
+#endif
+  benchmark::State& state_;
+};
+
+#endif
@@ -0,0 +1,76 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "variant.h"
+#include "vpool.h"
+#include <benchmark/benchmark.h>
+
+namespace {
+using symbol = variant<int64_t, std::string>;
+using pool = variant_pool<int64_t, std::string>;
+
+constexpr size_t values = 1 << 16;
+constexpr size_t distinct = 512;
+
+// Symbol-heavy data: many repetitions of a few hundred long identifiers, with some integers mixed in.
+symbol make_symbol(size_t i) {
+  size_t id = (i * 2654435761u) % distinct;
+  if (id % 8 == 0) {
+    return int64_t(id);
+  }
+  return "namespace::module::identifier_" + std::to_string(id);
+}
+
+void BM_compare_variants(benchmark::State& state) {
+  std::vector<symbol> data;
+  for (size_t i = 0; i < values; ++i) {
+    data.push_back(make_symbol(i));
+  }
+  size_t equal = 0;
+  for (auto _ : state) {
+    for (size_t i = 1; i < values; ++i) {
+      equal += data[i] == data[i - 1] || data[i] == data[(i * 7) % values];
+    }
+    benchmark::DoNotOptimize(equal);
+  }
+  state.counters["comparisons_per_second"] =
+      benchmark::Counter(double(2 * (values - 1)), benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void BM_compare_handles(benchmark::State& state) {
+  pool p;
+  std::vector<pool::handle> data;
+  for (size_t i = 0; i < values; ++i) {
+    data.push_back(p.intern(make_symbol(i)));
+  }
+  size_t equal = 0;
+  for (auto _ : state) {
+    for (size_t i = 1; i < values; ++i) {
+      equal += data[i] == data[i - 1] || data[i] == data[(i * 7) % values];
+    }
+    benchmark::DoNotOptimize(equal);
+  }
+  state.counters["comparisons_per_second"] =
+      benchmark::Counter(double(2 * (values - 1)), benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void BM_intern(benchmark::State& state) {
+  std::vector<symbol> data;
+  for (size_t i = 0; i < values; ++i) {
+    data.push_back(make_symbol(i));
+  }
+  for (auto _ : state) {
+    pool p;
+    for (const auto& s : data) {
+      benchmark::DoNotOptimize(p.intern(s));
+    }
+  }
+  state.counters["interns_per_second"] =
+      benchmark::Counter(double(values), benchmark::Counter::kIsIterationInvariantRate);
+}
+} // namespace
+
+BENCHMARK(BM_compare_variants);
+BENCHMARK(BM_compare_handles);
+BENCHMARK(BM_intern);
@@ -0,0 +1,154 @@
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "variant.h"
+#include "vqueue.h"
+#include <benchmark/benchmark.h>
+
+namespace {
+struct order {
+  uint64_t id;
+  double price;
+  uint32_t quantity;
+};
+
+struct cancel {
+  uint64_t id;
+};
+
+using message = variant<uint64_t, order, cancel, std::string>;
+using spsc = spsc_queue<uint64_t, order, cancel, std::string>;
+using mpmc = mpmc_queue<uint64_t, order, cancel, std::string>;
+
+constexpr uint64_t messages = 1 << 20;
+
+struct checksum {
+  void operator()(uint64_t value) {
+    sum += value;
+  }
+  void operator()(const order& o) {
+    sum += o.id + o.quantity;
+  }
+  void operator()(const cancel& c) {
+    sum += c.id;
+  }
+  void operator()(const std::string& s) {
+    sum += s.size();
+  }
+
+  uint64_t sum = 0;
+};
+
+template <typename Queue>
+void produce(Queue& queue) {
+  for (uint64_t i = 0; i < messages; ++i) {
+    switch (i % 4) {
+    case 0:
+      queue.template emplace<0>(i);
+      break;
+    case 1:
+      queue.template emplace<1>(order{i, 1.5, 10});
+      break;
+    case 2:
+      queue.template emplace<2>(cancel{i});
+      break;
+    default:
+      queue.template emplace<3>(8, 'x');
+      break;
+    }
+  }
+}
+
+// The pattern the in-place queues replace: a ring of variants where the producer builds a temporary variant and
+// move-assigns it into the slot, and the consumer moves it out before visiting.
+class move_ring {
+public:
+  explicit move_ring(size_t capacity) : mask_(capacity - 1), slots_(std::make_unique<message[]>(capacity)) {}
+
+  template <size_t Index, typename... Args>
+  void emplace(Args&&... args) {
+    message value(in_place_index<Index>, std::forward<Args>(args)...);
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    while (tail - head_cache_ > mask_ && tail - (head_cache_ = head_.load(std::memory_order_acquire)) > mask_) {
+      std::this_thread::yield();
+    }
+    slots_[tail & mask_] = std::move(value);
+    tail_.store(tail + 1, std::memory_order_release);
+  }
+
+  template <typename F>
+  void consume(F&& visitor) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    while (head == tail_cache_ && head == (tail_cache_ = tail_.load(std::memory_order_acquire))) {
+      std::this_thread::yield();
+    }
+    message value = std::move(slots_[head & mask_]);
+    head_.store(head + 1, std::memory_order_release);
+    visit(visitor, value);
+  }
+
+private:
+  size_t mask_;
+  std::unique_ptr<message[]> slots_;
+  alignas(64) std::atomic<size_t> tail_{0};
+  size_t head_cache_ = 0;
+  alignas(64) std::atomic<size_t> head_{0};
+  size_t tail_cache_ = 0;
+};
+
+template <typename Queue>
+void BM_queue(benchmark::State& state) {
+  checksum result;
+  for (auto _ : state) {
+    Queue queue(1024);
+    result = {};
+    std::thread producer([&queue] { produce(queue); });
+    for (uint64_t i = 0; i < messages; ++i) {
+      queue.consume(result);
+    }
+    producer.join();
+    benchmark::DoNotOptimize(result);
+  }
+  state.counters["checksum"] = static_cast<double>(result.sum);
+  state.counters["messages_per_second"] =
+      benchmark::Counter(static_cast<double>(messages), benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void BM_mpmc_queue(benchmark::State& state) {
+  const auto threads = static_cast<size_t>(state.range(0));
+  for (auto _ : state) {
+    mpmc queue(1024);
+    std::atomic<uint64_t> sum = 0;
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+      workers.emplace_back([&queue] {
+        for (uint64_t i = 0; i < messages / 4; ++i) {
+          queue.emplace<1>(order{i, 1.5, 10});
+        }
+      });
+      workers.emplace_back([&queue, &sum] {
+        checksum local;
+        for (uint64_t i = 0; i < messages / 4; ++i) {
+          queue.consume(local);
+        }
+        sum += local.sum;
+      });
+    }
+    for (auto& worker : workers) {
+      worker.join();
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.counters["messages_per_second"] = benchmark::Counter(static_cast<double>(threads * (messages / 4)),
+                                                             benchmark::Counter::kIsIterationInvariantRate);
+}
+} // namespace
+
+BENCHMARK_TEMPLATE(BM_queue, spsc)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_queue, mpmc)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_queue, move_ring)->UseRealTime();
+BENCHMARK(BM_mpmc_queue)->Arg(1)->Arg(2)->Arg(4)->UseRealTime();
@@ -0,0 +1,52 @@
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "variant.h"
+#include "vshared.h"
+#include <benchmark/benchmark.h>
+
+namespace {
+using config = std::map<std::string, std::string>;
+using document = std::vector<std::string>;
+
+constexpr size_t subscribers = 256;
+
+config make_config() {
+  config result;
+  for (int i = 0; i < 200; ++i) {
+    result.emplace("key-" + std::to_string(i), std::string(32, char('a' + i % 26)));
+  }
+  return result;
+}
+
+template <typename Message>
+size_t read(const Message& m) {
+  return visit([](const auto& payload) -> size_t { return payload.size(); }, m);
+}
+
+// Delivers one message to every subscriber's inbox, as a pub/sub fan-out does, and has each of them read it.
+template <typename Message>
+void BM_fan_out(benchmark::State& state) {
+  const Message message(in_place_index<0>, make_config());
+  std::vector<Message> inboxes;
+  inboxes.reserve(subscribers);
+  size_t total = 0;
+  for (auto _ : state) {
+    inboxes.clear();
+    for (size_t i = 0; i < subscribers; ++i) {
+      inboxes.push_back(message);
+    }
+    for (const auto& inbox : inboxes) {
+      total += read(inbox);
+    }
+    benchmark::DoNotOptimize(total);
+  }
+  state.counters["deliveries_per_second"] =
+      benchmark::Counter(static_cast<double>(subscribers), benchmark::Counter::kIsIterationInvariantRate);
+}
+} // namespace
+
+BENCHMARK_TEMPLATE(BM_fan_out, variant<config, document>);
+BENCHMARK_TEMPLATE(BM_fan_out, shared_variant<config, document>);
@@ -0,0 +1,127 @@
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "variant.h"
+#include "vtask.h"
+#include <benchmark/benchmark.h>
+
+namespace {
+constexpr uint64_t races = 1 << 16;
+
+task<uint64_t> tick(event_loop& loop, int hops, uint64_t value) {
+  for (int i = 0; i < hops; ++i) {
+    co_await loop.schedule();
+  }
+  co_return value;
+}
+
+task<double> tock(event_loop& loop, int hops, double value) {
+  for (int i = 0; i < hops; ++i) {
+    co_await loop.schedule();
+  }
+  co_return value;
+}
+
+task<uint64_t> race_all(event_loop& loop) {
+  uint64_t sum = 0;
+  for (uint64_t i = 0; i < races; ++i) {
+    auto result = co_await when_any(tick(loop, 1 + int(i & 1), i), tock(loop, 2 - int(i & 1), 0.5));
+    sum += result.index() == 0 ? get<0>(result) : 1;
+  }
+  co_return sum;
+}
+
+void BM_when_any(benchmark::State& state) {
+  event_loop loop;
+  uint64_t sum = 0;
+  for (auto _ : state) {
+    sum = loop.run(race_all(loop));
+    benchmark::DoNotOptimize(sum);
+  }
+  state.counters["checksum"] = static_cast<double>(sum);
+  state.counters["races_per_second"] =
+      benchmark::Counter(static_cast<double>(races), benchmark::Counter::kIsIterationInvariantRate);
+}
+
+// The callback style when_any replaces: every operation takes a std::function completion, the race keeps its state
+// in a shared_ptr, and the loop queues type-erased callbacks.
+class callback_loop {
+public:
+  void post(std::function<void()> f) {
+    ready_.push_back(std::move(f));
+  }
+
+  void run() {
+    while (!ready_.empty()) {
+      auto f = std::move(ready_.front());
+      ready_.pop_front();
+      f();
+    }
+  }
+
+private:
+  std::deque<std::function<void()>> ready_;
+};
+
+template <typename T>
+void after(callback_loop& loop, int hops, T value, std::function<void(T)> done) {
+  if (hops == 0) {
+    done(std::move(value));
+    return;
+  }
+  loop.post([&loop, hops, value = std::move(value), done = std::move(done)]() mutable {
+    after(loop, hops - 1, std::move(value), std::move(done));
+  });
+}
+
+using race_result = variant<uint64_t, double>;
+
+void callback_race(callback_loop& loop, uint64_t i, std::function<void(race_result)> done) {
+  struct race {
+    bool settled = false;
+    std::function<void(race_result)> done;
+  };
+  auto shared = std::make_shared<race>(race{false, std::move(done)});
+  after<uint64_t>(loop, 1 + int(i & 1), i, [shared](uint64_t v) {
+    if (!std::exchange(shared->settled, true)) {
+      shared->done(race_result(in_place_index<0>, v));
+    }
+  });
+  after<double>(loop, 2 - int(i & 1), 0.5, [shared](double v) {
+    if (!std::exchange(shared->settled, true)) {
+      shared->done(race_result(in_place_index<1>, v));
+    }
+  });
+}
+
+void callback_race_all(callback_loop& loop, uint64_t i, uint64_t& sum) {
+  if (i == races) {
+    return;
+  }
+  callback_race(loop, i, [&loop, i, &sum](race_result result) {
+    sum += result.index() == 0 ? get<0>(result) : 1;
+    callback_race_all(loop, i + 1, sum);
+  });
+}
+
+void BM_callback_any(benchmark::State& state) {
+  callback_loop loop;
+  uint64_t sum = 0;
+  for (auto _ : state) {
+    sum = 0;
+    callback_race_all(loop, 0, sum);
+    loop.run();
+    benchmark::DoNotOptimize(sum);
+  }
+  state.counters["checksum"] = static_cast<double>(sum);
+  state.counters["races_per_second"] =
+      benchmark::Counter(static_cast<double>(races), benchmark::Counter::kIsIterationInvariantRate);
+}
+} // namespace
+
+BENCHMARK(BM_when_any);
+BENCHMARK(BM_callback_any);
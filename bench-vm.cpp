@@ -0,0 +1,534 @@
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "variant.h"
+#include <benchmark/benchmark.h>
+
+namespace {
+struct local_policy {
+  template <typename... Types>
+  using variant_t = ::variant<Types...>;
+
+  template <size_t Index, typename V>
+  static decltype(auto) get(V&& v) {
+    return ::get<Index>(std::forward<V>(v));
+  }
+
+  template <typename F, typename... Vs>
+  static decltype(auto) visit(F&& f, Vs&&... vs) {
+    return ::visit(std::forward<F>(f), std::forward<Vs>(vs)...);
+  }
+};
+
+struct std_policy {
+  template <typename... Types>
+  using variant_t = std::variant<Types...>;
+
+  template <size_t Index, typename V>
+  static decltype(auto) get(V&& v) {
+    return std::get<Index>(std::forward<V>(v));
+  }
+
+  template <typename F, typename... Vs>
+  static decltype(auto) visit(F&& f, Vs&&... vs) {
+    return std::visit(std::forward<F>(f), std::forward<Vs>(vs)...);
+  }
+};
+
+enum class op : uint8_t {
+  push_const,
+  load_local,
+  store_local,
+  pop,
+  add,
+  sub,
+  mul,
+  lt,
+  eq,
+  jump,
+  jump_if_false,
+  call,
+  ret,
+  list_new,
+  list_push,
+  list_get,
+  list_len,
+};
+
+struct instr {
+  op code;
+  uint32_t arg = 0;
+};
+
+struct function {
+  uint32_t entry;
+  uint32_t arity;
+  uint32_t locals;
+
+  friend bool operator==(const function& a, const function& b) noexcept {
+    return a.entry == b.entry;
+  }
+};
+
+template <typename Policy>
+struct basic_list;
+
+template <typename Policy>
+using value_t = typename Policy::template variant_t<double, std::shared_ptr<const std::string>,
+                                                    std::shared_ptr<basic_list<Policy>>, function>;
+
+template <typename Policy>
+struct basic_list {
+  std::vector<value_t<Policy>> items;
+};
+
+struct program {
+  std::vector<instr> code;
+  std::vector<function> functions;
+  std::vector<double> numbers;
+  std::vector<std::string> strings;
+  uint32_t main;
+};
+
+template <typename Policy>
+class vm {
+public:
+  using value = value_t<Policy>;
+  using list = basic_list<Policy>;
+
+  explicit vm(const program& p) : program_(p) {
+    for (double d : p.numbers) {
+      constants_.emplace_back(d);
+    }
+    for (const auto& s : p.strings) {
+      constants_.emplace_back(std::make_shared<const std::string>(s));
+    }
+    for (const auto& f : p.functions) {
+      constants_.emplace_back(f);
+    }
+    stack_.reserve(1 << 16);
+  }
+
+  value run() {
+    stack_.clear();
+    frames_.clear();
+    const function& entry = program_.functions[program_.main];
+    stack_.emplace_back(entry);
+    enter(entry, stack_.size());
+    const instr* code = program_.code.data();
+    size_t ip = entry.entry;
+    while (true) {
+      const instr& in = code[ip++];
+      switch (in.code) {
+      case op::push_const:
+        stack_.push_back(constants_[in.arg]);
+        break;
+      case op::load_local:
+        stack_.push_back(stack_[frames_.back().base + in.arg]);
+        break;
+      case op::store_local:
+        stack_[frames_.back().base + in.arg] = std::move(stack_.back());
+        stack_.pop_back();
+        break;
+      case op::pop:
+        stack_.pop_back();
+        break;
+      case op::add:
+        binary(arith<std::plus<>, true>{});
+        break;
+      case op::sub:
+        binary(arith<std::minus<>, false>{});
+        break;
+      case op::mul:
+        binary(arith<std::multiplies<>, false>{});
+        break;
+      case op::lt:
+        binary(less{});
+        break;
+      case op::eq: {
+        bool result = stack_[stack_.size() - 2] == stack_.back();
+        stack_.pop_back();
+        stack_.back() = result ? 1.0 : 0.0;
+        break;
+      }
+      case op::jump:
+        ip = in.arg;
+        break;
+      case op::jump_if_false: {
+        bool truthy = Policy::template get<0>(stack_.back()) != 0.0;
+        stack_.pop_back();
+        if (!truthy) {
+          ip = in.arg;
+        }
+        break;
+      }
+      case op::call: {
+        const function& callee = Policy::template get<3>(stack_[stack_.size() - in.arg - 1]);
+        if (callee.arity != in.arg) {
+          throw std::runtime_error("arity mismatch");
+        }
+        frames_.back().return_ip = ip;
+        enter(callee, stack_.size() - in.arg);
+        ip = callee.entry;
+        break;
+      }
+      case op::ret: {
+        value result = std::move(stack_.back());
+        size_t base = frames_.back().base;
+        frames_.pop_back();
+        stack_.resize(base - 1);
+        if (frames_.empty()) {
+          return result;
+        }
+        stack_.push_back(std::move(result));
+        ip = frames_.back().return_ip;
+        break;
+      }
+      case op::list_new:
+        stack_.emplace_back(std::make_shared<list>());
+        break;
+      case op::list_push: {
+        value item = std::move(stack_.back());
+        stack_.pop_back();
+        Policy::template get<2>(stack_.back())->items.push_back(std::move(item));
+        break;
+      }
+      case op::list_get: {
+        auto index = static_cast<size_t>(Policy::template get<0>(stack_.back()));
+        stack_.pop_back();
+        value item = Policy::template get<2>(stack_.back())->items.at(index);
+        stack_.back() = std::move(item);
+        break;
+      }
+      case op::list_len: {
+        auto size = static_cast<double>(Policy::template get<2>(stack_.back())->items.size());
+        stack_.back() = size;
+        break;
+      }
+      }
+    }
+  }
+
+private:
+  struct frame {
+    size_t base;
+    size_t return_ip;
+  };
+
+  template <typename Op, bool Concat>
+  struct arith {
+    value operator()(double a, double b) const {
+      return Op{}(a, b);
+    }
+
+    value operator()(const std::shared_ptr<const std::string>& a, const std::shared_ptr<const std::string>& b) const {
+      if constexpr (Concat) {
+        return std::make_shared<const std::string>(*a + *b);
+      } else {
+        throw std::runtime_error("unsupported string operation");
+      }
+    }
+
+    template <typename A, typename B>
+    value operator()(const A&, const B&) const {
+      throw std::runtime_error("type error");
+    }
+  };
+
+  struct less {
+    value operator()(double a, double b) const {
+      return a < b ? 1.0 : 0.0;
+    }
+
+    value operator()(const std::shared_ptr<const std::string>& a, const std::shared_ptr<const std::string>& b) const {
+      return *a < *b ? 1.0 : 0.0;
+    }
+
+    template <typename A, typename B>
+    value operator()(const A&, const B&) const {
+      throw std::runtime_error("type error");
+    }
+  };
+
+  template <typename F>
+  void binary(F f) {
+    value result = Policy::visit(f, stack_[stack_.size() - 2], stack_.back());
+    stack_.pop_back();
+    stack_.back() = std::move(result);
+  }
+
+  void enter(const function& f, size_t base) {
+    frames_.push_back({base, 0});
+    for (uint32_t i = f.arity; i < f.locals; ++i) {
+      stack_.emplace_back(0.0);
+    }
+  }
+
+  const program& program_;
+  std::vector<value> constants_;
+  std::vector<value> stack_;
+  std::vector<frame> frames_;
+};
+
+class assembler {
+public:
+  uint32_t number(double d) {
+    program_.numbers.push_back(d);
+    return static_cast<uint32_t>(program_.numbers.size() - 1);
+  }
+
+  uint32_t string(std::string s) {
+    program_.strings.push_back(std::move(s));
+    return static_cast<uint32_t>(program_.strings.size() - 1);
+  }
+
+  uint32_t function(uint32_t arity, uint32_t locals) {
+    program_.functions.push_back({here(), arity, locals});
+    return static_cast<uint32_t>(program_.functions.size() - 1);
+  }
+
+  uint32_t here() const {
+    return static_cast<uint32_t>(program_.code.size());
+  }
+
+  void emit(op code, uint32_t arg = 0) {
+    program_.code.push_back({code, arg});
+  }
+
+  void patch(uint32_t at, uint32_t target) {
+    program_.code[at].arg = target;
+  }
+
+  void push_number(uint32_t k) {
+    emit(op::push_const, k);
+  }
+
+  void push_string(uint32_t k) {
+    emit(op::push_const, static_cast<uint32_t>(program_.numbers.size()) + k);
+  }
+
+  void push_function(uint32_t k) {
+    emit(op::push_const, static_cast<uint32_t>(program_.numbers.size() + program_.strings.size()) + k);
+  }
+
+  program finish(uint32_t main) {
+    program_.main = main;
+    return std::move(program_);
+  }
+
+private:
+  program program_;
+};
+
+// acc = sum(i * 2 - 1) for i in [0, n)
+program arithmetic_script(double n) {
+  assembler a;
+  uint32_t zero = a.number(0), one = a.number(1), two = a.number(2), limit = a.number(n);
+  uint32_t main = a.function(0, 2);
+  a.push_number(zero);
+  a.emit(op::store_local, 0);
+  a.push_number(zero);
+  a.emit(op::store_local, 1);
+  uint32_t loop = a.here();
+  a.emit(op::load_local, 0);
+  a.push_number(limit);
+  a.emit(op::lt);
+  uint32_t exit = a.here();
+  a.emit(op::jump_if_false);
+  a.emit(op::load_local, 1);
+  a.emit(op::load_local, 0);
+  a.push_number(two);
+  a.emit(op::mul);
+  a.emit(op::add);
+  a.push_number(one);
+  a.emit(op::sub);
+  a.emit(op::store_local, 1);
+  a.emit(op::load_local, 0);
+  a.push_number(one);
+  a.emit(op::add);
+  a.emit(op::store_local, 0);
+  a.emit(op::jump, loop);
+  a.patch(exit, a.here());
+  a.emit(op::load_local, 1);
+  a.emit(op::ret);
+  return a.finish(main);
+}
+
+// counts loop iterations where i < n / 2 plus iterations where the name (alternating string/number) equals "key"
+program comparison_script(double n) {
+  assembler a;
+  uint32_t zero = a.number(0), one = a.number(1), half = a.number(n / 2), limit = a.number(n);
+  uint32_t key = a.string("key"), other = a.string("other");
+  uint32_t main = a.function(0, 3);
+  a.push_number(zero);
+  a.emit(op::store_local, 0);
+  a.push_number(zero);
+  a.emit(op::store_local, 1);
+  uint32_t loop = a.here();
+  a.emit(op::load_local, 0);
+  a.push_number(limit);
+  a.emit(op::lt);
+  uint32_t exit = a.here();
+  a.emit(op::jump_if_false);
+  a.emit(op::load_local, 0);
+  a.push_number(half);
+  a.emit(op::lt);
+  uint32_t skip_half = a.here();
+  a.emit(op::jump_if_false);
+  a.emit(op::load_local, 1);
+  a.push_number(one);
+  a.emit(op::add);
+  a.emit(op::store_local, 1);
+  a.patch(skip_half, a.here());
+  a.emit(op::load_local, 2);
+  a.push_string(key);
+  a.emit(op::eq);
+  uint32_t pick_key = a.here();
+  a.emit(op::jump_if_false);
+  a.emit(op::load_local, 1);
+  a.push_number(one);
+  a.emit(op::add);
+  a.emit(op::store_local, 1);
+  a.push_string(other);
+  a.emit(op::store_local, 2);
+  uint32_t next = a.here();
+  a.emit(op::jump);
+  a.patch(pick_key, a.here());
+  a.push_string(key);
+  a.emit(op::store_local, 2);
+  a.patch(next, a.here());
+  a.emit(op::load_local, 0);
+  a.push_number(one);
+  a.emit(op::add);
+  a.emit(op::store_local, 0);
+  a.emit(op::jump, loop);
+  a.patch(exit, a.here());
+  a.emit(op::load_local, 1);
+  a.emit(op::ret);
+  return a.finish(main);
+}
+
+// fib(n) computed recursively
+program call_script(double n) {
+  assembler a;
+  uint32_t one = a.number(1), two = a.number(2), arg = a.number(n);
+  uint32_t fib = a.function(1, 1);
+  a.emit(op::load_local, 0);
+  a.push_number(two);
+  a.emit(op::lt);
+  uint32_t recurse = a.here();
+  a.emit(op::jump_if_false);
+  a.emit(op::load_local, 0);
+  a.emit(op::ret);
+  a.patch(recurse, a.here());
+  a.push_function(fib);
+  a.emit(op::load_local, 0);
+  a.push_number(one);
+  a.emit(op::sub);
+  a.emit(op::call, 1);
+  a.push_function(fib);
+  a.emit(op::load_local, 0);
+  a.push_number(two);
+  a.emit(op::sub);
+  a.emit(op::call, 1);
+  a.emit(op::add);
+  a.emit(op::ret);
+  uint32_t main = a.function(0, 0);
+  a.push_function(fib);
+  a.push_number(arg);
+  a.emit(op::call, 1);
+  a.emit(op::ret);
+  return a.finish(main);
+}
+
+// builds a list of [0, n) and sums it back through list_get
+program list_script(double n) {
+  assembler a;
+  uint32_t zero = a.number(0), one = a.number(1), limit = a.number(n);
+  uint32_t main = a.function(0, 3);
+  a.emit(op::list_new);
+  a.emit(op::store_local, 2);
+  a.push_number(zero);
+  a.emit(op::store_local, 0);
+  uint32_t fill = a.here();
+  a.emit(op::load_local, 0);
+  a.push_number(limit);
+  a.emit(op::lt);
+  uint32_t fill_exit = a.here();
+  a.emit(op::jump_if_false);
+  a.emit(op::load_local, 2);
+  a.emit(op::load_local, 0);
+  a.emit(op::list_push);
+  a.emit(op::pop);
+  a.emit(op::load_local, 0);
+  a.push_number(one);
+  a.emit(op::add);
+  a.emit(op::store_local, 0);
+  a.emit(op::jump, fill);
+  a.patch(fill_exit, a.here());
+  a.push_number(zero);
+  a.emit(op::store_local, 0);
+  a.push_number(zero);
+  a.emit(op::store_local, 1);
+  uint32_t sum = a.here();
+  a.emit(op::load_local, 0);
+  a.emit(op::load_local, 2);
+  a.emit(op::list_len);
+  a.emit(op::lt);
+  uint32_t sum_exit = a.here();
+  a.emit(op::jump_if_false);
+  a.emit(op::load_local, 1);
+  a.emit(op::load_local, 2);
+  a.emit(op::load_local, 0);
+  a.emit(op::list_get);
+  a.emit(op::add);
+  a.emit(op::store_local, 1);
+  a.emit(op::load_local, 0);
+  a.push_number(one);
+  a.emit(op::add);
+  a.emit(op::store_local, 0);
+  a.emit(op::jump, sum);
+  a.patch(sum_exit, a.here());
+  a.emit(op::load_local, 1);
+  a.emit(op::ret);
+  return a.finish(main);
+}
+
+struct script {
+  const char* name;
+  program (*make)(double);
+  double n;
+  double expected;
+};
+
+const script scripts[] = {
+    {"arithmetic", arithmetic_script, 100000, 100000.0 * 99999 - 100000},
+    {"comparison", comparison_script, 100000, 100000},
+    {"calls", call_script, 20, 6765},
+    {"lists", list_script, 20000, 20000.0 * 19999 / 2},
+};
+
+template <typename Policy>
+void BM_vm(benchmark::State& state) {
+  const script& s = scripts[state.range(0)];
+  program p = s.make(s.n);
+  vm<Policy> machine(p);
+  double result = 0;
+  for (auto _ : state) {
+    auto value = machine.run();
+    benchmark::DoNotOptimize(value);
+    result = Policy::template get<0>(value);
+  }
+  if (result != s.expected) {
+    state.SkipWithError("script returned an unexpected result");
+  }
+  state.SetLabel(s.name);
+}
+} // namespace
+
+BENCHMARK_TEMPLATE(BM_vm, local_policy)->DenseRange(0, std::size(scripts) - 1);
+BENCHMARK_TEMPLATE(BM_vm, std_policy)->DenseRange(0, std::size(scripts) - 1);
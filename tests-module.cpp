@@ -0,0 +1,23 @@
+#include <string>
+#include "gtest/gtest.h"
+
+import variant;
+
+TEST(module, access) {
+  variant<int, std::string> v = 5;
+  ASSERT_EQ(get<0>(v), 5);
+  ASSERT_TRUE(holds_alternative<int>(v));
+  v = "text";
+  ASSERT_EQ(get<std::string>(v), "text");
+  ASSERT_EQ(get_if<0>(&v), nullptr);
+  ASSERT_THROW(static_cast<void>(get<0>(v)), bad_variant_access);
+}
+
+TEST(module, visit) {
+  variant<int, double> a = 2.5;
+  variant<int, double> b = 3;
+  ASSERT_EQ(visit([](auto x, auto y) { return double(x) + double(y); }, a, b), 5.5);
+  ASSERT_TRUE(b < a);
+  a.emplace<int>(3);
+  ASSERT_TRUE(a == b);
+}
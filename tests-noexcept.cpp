@@ -0,0 +1,46 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+[[noreturn]] void access_failure(const char* what) {
+  std::fprintf(stderr, "access failure: %s\n", what);
+  std::abort();
+}
+
+#define VARIANT_ACCESS_FAILURE_HANDLER access_failure
+
+#include "variant.h"
+#include "vexpected.h"
+#include "gtest/gtest.h"
+
+#ifndef VARIANT_NO_EXCEPTIONS
+#error "tests-noexcept must be built with exceptions disabled"
+#endif
+
+TEST(no_exceptions, access) {
+  variant<int, std::string, std::vector<int>> v = 5;
+  ASSERT_EQ(get<0>(v), 5);
+  ASSERT_EQ(get_if<1>(&v), nullptr);
+  v = "text";
+  ASSERT_EQ(get<std::string>(v), "text");
+  v.emplace<2>(3, 7);
+  ASSERT_EQ(get<2>(v).size(), 3);
+  ASSERT_EQ(visit([](const auto& value) { return sizeof(value); }, v), sizeof(std::vector<int>));
+  auto copy = v;
+  ASSERT_TRUE(copy == v);
+  ASSERT_FALSE(v.valueless_by_exception());
+}
+
+TEST(no_exceptions_death, failed_access_calls_handler) {
+  variant<int, std::string> v = 5;
+  ASSERT_DEATH(static_cast<void>(get<1>(v)), "access failure: bad variant access");
+  ASSERT_DEATH(static_cast<void>(get<std::string>(v)), "access failure: bad variant access");
+}
+
+TEST(no_exceptions, expected) {
+  expected<int, std::string> e = unexpected(std::string("error"));
+  ASSERT_EQ(e.error(), "error");
+  ASSERT_EQ(e.transform([](int x) { return x + 1; }).value_or(0), 0);
+  ASSERT_DEATH(static_cast<void>(e.value()), "access failure: bad expected access");
+}
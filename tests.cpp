@@ -1,11 +1,31 @@
+#include <array>
 #include <exception>
+#include <filesystem>
+#include <set>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <type_traits>
 #include <utility>
+#include <variant>
 #include <vector>
 
 #include "test-classes.h"
 #include "variant.h"
+#include "vcolumn.h"
+#include "vstream.h"
+#include "vref.h"
+#include "vfsm.h"
+#include "vqueue.h"
+#include "vhash_map.h"
+#include "vtask.h"
+#include "vexpected.h"
+#include "vshared.h"
+#include "vpool.h"
+#include "vversioned.h"
+#include "vcommon.h"
+#include "vflat.h"
+#include "vcast.h"
 #include "gtest/gtest.h"
 
 TEST(traits, destructor) {
@@ -402,6 +422,70 @@ TEST(correctness, inplace_ctors) {
   ASSERT_EQ(get<1>(var2), other2);
 }
 
+namespace factory {
+// Neither copyable nor movable, like a type holding a mutex; only a factory's prvalue can put it in a variant.
+struct pinned {
+  explicit constexpr pinned(int v) : value(v) {}
+  pinned(const pinned&) = delete;
+  pinned& operator=(const pinned&) = delete;
+
+  int value;
+};
+
+constexpr pinned make_pinned(int v) {
+  return pinned(v);
+}
+
+// Constructible from anything, so it would take a wrapper around the factory instead of the factory's result.
+struct greedy {
+  template <typename U>
+  constexpr greedy(U&& u) : value(std::is_same_v<std::remove_cvref_t<U>, int> ? static_cast<int>(u) : -1) {}
+
+  int value;
+};
+
+constexpr bool in_place_factory_ctor() {
+  variant<bool, double, pinned> x1(in_place_factory<1>, [] { return 4.5; });
+  variant<bool, double, pinned> x2(in_place_factory<2>, [] { return make_pinned(7); });
+  x1.emplace_with<pinned>([] { return make_pinned(8); });
+  variant<greedy, int> x3(in_place_factory<0>, [] { return greedy(5); });
+  x3.emplace_with<0>([] { return greedy(6); });
+  return get<2>(x1).value == 8 && get<2>(x2).value == 7 && get<0>(x3).value == 6;
+}
+
+static_assert(in_place_factory_ctor());
+} // namespace factory
+
+TEST(correctness, emplace_with) {
+  using factory::make_pinned;
+  using factory::pinned;
+  using V = variant<std::string, pinned>;
+  static_assert(std::is_constructible_v<V, in_place_factory_t<1>, pinned (*)()>);
+  static_assert(!std::is_constructible_v<V, in_place_factory_t<1>, std::string (*)()>);
+  static_assert(!std::is_constructible_v<V, in_place_factory_t<2>, pinned (*)()>);
+
+  V v(in_place_factory<0>, [] { return std::string("built"); });
+  ASSERT_EQ(get<0>(v), "built");
+  pinned& p = v.emplace_with<1>([] { return make_pinned(3); });
+  ASSERT_EQ(&p, get_if<1>(&v));
+  ASSERT_EQ(p.value, 3);
+  v.emplace_with<std::string>([] { return std::string(40, 'x'); });
+  ASSERT_EQ(get<0>(v), std::string(40, 'x'));
+
+  ASSERT_THROW(v.emplace_with<1>([]() -> pinned { throw std::exception(); }), std::exception);
+  ASSERT_TRUE(v.valueless_by_exception());
+}
+
+TEST(correctness, emplace_with_forwarding_constructor) {
+  using factory::greedy;
+  variant<greedy, int> v(in_place_factory<0>, [] { return greedy(3); });
+  ASSERT_EQ(get<0>(v).value, 3);
+  v = 1;
+  ASSERT_EQ(v.emplace_with<0>([] { return greedy(7); }).value, 7);
+  ASSERT_EQ(v.index(), 0);
+  ASSERT_EQ(get<0>(v).value, 7);
+}
+
 TEST(correctness, variant_exceptions1) {
   variant<throwing_move_operator_t> x;
   try {
@@ -576,6 +660,53 @@ TEST(visits, visit_args_forwarding) {
   ASSERT_EQ(val4, 322);
 }
 
+using wide_variant = variant<char, short, int, long, long long, unsigned>;
+
+constexpr bool test_wide_visit() {
+  wide_variant a(in_place_index<1>, 1);
+  wide_variant b(in_place_index<3>, 2);
+  wide_variant c(in_place_index<4>, 3);
+  wide_variant d(in_place_index<5>, 4u);
+  return visit(sqr_sum_visitor{}, a, b, c, d) == 30;
+}
+
+static_assert(test_wide_visit(), "Wide visit is not constexpr");
+
+TEST(visits, visit_wide) {
+  wide_variant a(in_place_index<2>, 1);
+  wide_variant b(in_place_index<0>, char(2));
+  wide_variant c(in_place_index<5>, 3u);
+  wide_variant d(in_place_index<4>, 4LL);
+  ASSERT_EQ(visit(sqr_sum_visitor{}, a, b, c, d), 30);
+
+  auto sizes = [](auto... args) { return std::vector<size_t>{sizeof(args)...}; };
+  ASSERT_EQ(visit(sizes, a, b, c, d), (std::vector<size_t>{sizeof(int), 1, sizeof(unsigned), sizeof(long long)}));
+
+  variant<only_movable> m;
+  int moved = visit([](only_movable&&, auto&&...) { return 1; }, std::move(m), wide_variant(), wide_variant(),
+                    wide_variant(), wide_variant());
+  ASSERT_EQ(moved, 1);
+}
+
+TEST(visits, visit_sparse) {
+  using V = variant<int, std::string, std::vector<int>>;
+  auto visitor = overload{[](int x, int y) { return x + y; },
+                         [](std::string const& str, int y) { return int(str.size()) * y; }};
+  V i = 2;
+  V s = std::string("abc");
+  V d = std::vector<int>{1};
+  ASSERT_EQ(visit_sparse<int>(visitor, i, i), 4);
+  ASSERT_EQ(visit_sparse<int>(visitor, s, i), 6);
+  ASSERT_THROW(visit_sparse<int>(visitor, i, s), bad_variant_access);
+  ASSERT_THROW(visit_sparse<int>(visitor, d, i), bad_variant_access);
+
+  wide_variant a(in_place_index<2>, 5);
+  wide_variant b(in_place_index<3>, 7L);
+  auto ints = [](int& x, long& y, auto&&...) -> long { return x * y; };
+  ASSERT_EQ(visit_sparse<long>(ints, a, b, wide_variant(), wide_variant()), 35);
+  ASSERT_THROW(visit_sparse<long>(ints, b, a, wide_variant(), wide_variant()), bad_variant_access);
+}
+
 TEST(swap, valueless) {
   throwing_move_operator_t::swap_called = 0;
   using V = variant<int, throwing_move_operator_t>;
@@ -740,3 +871,1566 @@ TEST(relops, relational_empty) {
     ASSERT_TRUE(test_less(v2, v1, false, false));
   }
 }
+
+static_assert(sizeof(variant_ref<int, std::string, std::vector<int>>) == 2 * sizeof(void*));
+static_assert(sizeof(variant_cref<int, std::string, std::vector<int>>) == 2 * sizeof(void*));
+static_assert(std::is_trivially_copyable_v<variant_ref<int, std::string>>);
+static_assert(std::is_constructible_v<variant_cref<int, std::string>, const std::string&>);
+static_assert(!std::is_constructible_v<variant_cref<int, std::string>, std::string>);
+static_assert(!std::is_constructible_v<variant_cref<int, std::string>, variant<int, std::string>>);
+static_assert(!std::is_constructible_v<variant_cref<int, std::string>, in_place_index_t<0>, int>);
+static_assert(!std::is_constructible_v<variant_ref<int, std::string>, std::string>);
+
+TEST(variant_ref, from_variant) {
+  using V = variant<int, std::string, std::vector<int>>;
+  V v(in_place_index<1>, "a fairly long string that will cause an allocation");
+  variant_ref<int, std::string, std::vector<int>> r = v;
+  ASSERT_EQ(r.index(), 1);
+  ASSERT_TRUE(holds_alternative<std::string>(r));
+  ASSERT_EQ(&get<1>(r), &get<1>(v));
+  get<std::string>(r) = "kek";
+  ASSERT_EQ(get<1>(v), "kek");
+  ASSERT_THROW(get<0>(r), bad_variant_access);
+  ASSERT_EQ(get_if<0>(&r), nullptr);
+  ASSERT_EQ(get_if<std::string>(&r), &get<1>(v));
+}
+
+TEST(variant_ref, from_alternative) {
+  std::vector<int> values = {1, 2, 3};
+  variant_ref<int, std::string, std::vector<int>> r = values;
+  ASSERT_EQ(r.index(), 2);
+  get<2>(r).push_back(4);
+  ASSERT_EQ(values.size(), 4);
+
+  int x = 42;
+  variant_ref<int, int> dup(in_place_index<1>, x);
+  ASSERT_EQ(dup.index(), 1);
+  ASSERT_EQ(&get<1>(dup), &x);
+
+  variant_cref<int, std::string, std::vector<int>> c = r;
+  ASSERT_EQ(c.index(), 2);
+  ASSERT_EQ(&get<std::vector<int>>(c), &values);
+}
+
+TEST(variant_ref, valueless) {
+  using V = variant<int, throwing_move_operator_t>;
+  V v = 42;
+  ASSERT_ANY_THROW({
+    V tmp(in_place_index<1>);
+    v = std::move(tmp);
+  });
+  variant_cref<int, throwing_move_operator_t> r = v;
+  ASSERT_TRUE(r.valueless_by_exception());
+  ASSERT_EQ(r.index(), variant_npos);
+  ASSERT_THROW(visit([](auto const&) {}, r), bad_variant_access);
+}
+
+TEST(variant_ref, visit) {
+  using V = variant<int, long, double>;
+  V v1 = 42;
+  long l = 1337L;
+  V v3 = 0.5;
+  auto result = visit([](auto const& i, auto& lr, auto const& d) -> double { return i + (lr += 1) + d; },
+                      variant_cref<int, long, double>(v1), variant_ref<int, long, double>(l), v3);
+  ASSERT_EQ(result, 42 + 1338L + 0.5);
+  ASSERT_EQ(l, 1338L);
+
+  variant_ref<int, long, double> r = v1;
+  visit([](auto& x) { x += 1; }, r);
+  ASSERT_EQ(get<0>(v1), 43);
+}
+
+TEST(variant_ref, relops) {
+  using V = variant<non_trivial_int_wrapper_t, int, std::string>;
+  using R = variant_cref<non_trivial_int_wrapper_t, int, std::string>;
+  V v1(in_place_index<0>, 42);
+  V v2(in_place_index<0>, 43);
+  V v3(in_place_index<1>, 42);
+  ASSERT_TRUE(test_equal(R(v1), R(v1), true));
+  ASSERT_TRUE(test_equal(R(v1), R(v2), false));
+  ASSERT_TRUE(test_equal(R(v1), R(v3), false));
+  ASSERT_TRUE(test_less(R(v1), R(v2), true, false));
+  ASSERT_TRUE(test_less(R(v2), R(v3), true, false));
+  ASSERT_TRUE(test_less(R(v3), R(v1), false, true));
+  ASSERT_EQ(R(v1) == R(v1), v1 == v1);
+  ASSERT_EQ(R(v1) < R(v3), v1 < v3);
+}
+
+TEST(column, round_trip) {
+  using V = variant<int, std::string, double>;
+  auto path = (std::filesystem::temp_directory_path() / "variant-column-round-trip.bin").string();
+  std::vector<V> rows;
+  for (int i = 0; i < 1000; ++i) {
+    if (i % 3 == 0) {
+      rows.emplace_back(in_place_index<0>, i);
+    } else if (i % 3 == 1) {
+      rows.emplace_back(in_place_index<1>, std::string(i % 17, 'a' + i % 26));
+    } else {
+      rows.emplace_back(in_place_index<2>, i * 0.5);
+    }
+  }
+  {
+    column_writer<int, std::string, double> writer;
+    for (auto const& row : rows) {
+      writer.push_back(row);
+    }
+    ASSERT_EQ(writer.size(), rows.size());
+    writer.write(path);
+  }
+
+  mapped_column<int, std::string, double> column(path);
+  ASSERT_EQ(column.size(), rows.size());
+  ASSERT_EQ(column.count<0>(), 334);
+  ASSERT_EQ(column.count<1>(), 333);
+  ASSERT_EQ(column.raw_section<2>().size(), 333 * sizeof(double));
+  for (size_t i = 0; i < rows.size(); ++i) {
+    ASSERT_EQ(column.index(i), rows[i].index());
+    ASSERT_TRUE(column[i] == rows[i]);
+  }
+  ASSERT_EQ(column.get<1>(4), get<1>(rows[4]));
+  ASSERT_THROW(column.get<0>(4), bad_variant_access);
+  ASSERT_EQ(column.visit(5, [](auto const& x) { return sizeof(x); }), sizeof(double));
+
+  long long sum = 0;
+  column.scan<0>([&sum](int x) { sum += x; });
+  ASSERT_EQ(sum, 3 * (333 * 334 / 2));
+  std::filesystem::remove(path);
+}
+
+TEST(column, rejects_mismatched_type) {
+  auto path = (std::filesystem::temp_directory_path() / "variant-column-mismatch.bin").string();
+  column_writer<int, double> writer;
+  writer.push_back(variant<int, double>(1.5));
+  writer.write(path);
+  ASSERT_THROW((mapped_column<int, float>(path)), column_error);
+  ASSERT_THROW((mapped_column<int, double, char>(path)), column_error);
+  ASSERT_EQ((mapped_column<int, double>(path).get<1>(0)), 1.5);
+  std::filesystem::remove(path);
+  ASSERT_THROW((mapped_column<int, double>(path)), column_error);
+}
+
+TEST(column, rejects_corrupted_rows) {
+  auto path = (std::filesystem::temp_directory_path() / "variant-column-corrupted.bin").string();
+  auto patch = [&path](bool tags, uint8_t byte) {
+    column_writer<int, double> writer;
+    writer.push_back(variant<int, double>(1));
+    writer.push_back(variant<int, double>(2.5));
+    writer.write(path);
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    details::column_header header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    file.seekp(static_cast<std::streamoff>(tags ? header.tags_offset : header.slots_offset));
+    file.put(static_cast<char>(byte));
+  };
+  patch(true, 2);
+  ASSERT_THROW((mapped_column<int, double>(path)), column_error);
+  patch(false, 1);
+  ASSERT_THROW((mapped_column<int, double>(path)), column_error);
+  patch(true, 0);
+  mapped_column<int, double> column(path);
+  ASSERT_EQ(column.get<0>(0), 1);
+  ASSERT_THROW(column.value<0>(1), column_error);
+  std::filesystem::remove(path);
+}
+
+TEST(stream, decode_across_chunks) {
+  using V = variant<int, std::string, double, char>;
+  std::vector<V> values = {V(42), V(std::string("short")), V(0.25), V('x'), V(std::string()),
+                           V(std::string(300, 'z')), V(-7)};
+  std::string encoded;
+  for (auto const& v : values) {
+    variant_encode(v, encoded);
+  }
+
+  for (size_t chunk_size : {size_t(1), size_t(2), size_t(3), size_t(7), size_t(64), encoded.size()}) {
+    stream_decoder<int, std::string, double, char> decoder;
+    std::vector<V> decoded;
+    for (size_t pos = 0; pos < encoded.size(); pos += chunk_size) {
+      decoder.feed(std::string_view(encoded).substr(pos, chunk_size), [&decoded](auto index, auto&& value) {
+        decoded.emplace_back(in_place_index<index>, std::forward<decltype(value)>(value));
+      });
+      ASSERT_LE(decoder.buffered(), 300);
+    }
+    ASSERT_TRUE(decoder.idle());
+    decoder.finish();
+    ASSERT_EQ(decoded.size(), values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+      ASSERT_TRUE(decoded[i] == values[i]);
+    }
+  }
+}
+
+TEST(stream, truncated_and_corrupted) {
+  std::string encoded;
+  variant_encode(variant<int, std::string>(std::string("payload")), encoded);
+  stream_decoder<int, std::string> decoder;
+  size_t count = decoder.feed(std::string_view(encoded).substr(0, encoded.size() - 1), [](auto, auto&&) {});
+  ASSERT_EQ(count, 0);
+  ASSERT_THROW(decoder.finish(), stream_error);
+
+  stream_decoder<int, std::string> bad;
+  ASSERT_THROW(bad.feed(std::string_view("\x05\x00\x00\x00\x00", 5), [](auto, auto&&) {}), stream_error);
+
+  stream_decoder<int, std::string> limited(4);
+  ASSERT_THROW(limited.feed(encoded, [](auto, auto&&) {}), stream_error);
+}
+
+TEST(stream, feed_before_drained) {
+  std::string encoded;
+  variant_encode(variant<int, std::string>(1), encoded);
+  variant_encode(variant<int, std::string>(2), encoded);
+  stream_decoder<int, std::string> decoder;
+  decoder.feed(encoded);
+  int first = 0;
+  ASSERT_TRUE(decoder.next([&first](auto, auto&& value) {
+    if constexpr (std::is_same_v<std::decay_t<decltype(value)>, int>) {
+      first = value;
+    }
+  }));
+  ASSERT_EQ(first, 1);
+  ASSERT_THROW(decoder.feed(encoded), stream_error);
+  ASSERT_TRUE(decoder.next([](auto, auto&&) {}));
+  ASSERT_FALSE(decoder.next([](auto, auto&&) {}));
+  ASSERT_EQ(decoder.feed(encoded, [](auto, auto&&) {}), 2);
+  decoder.finish();
+}
+
+TEST(stream, generator) {
+  using V = variant<int, std::string>;
+  std::string encoded;
+  for (int i = 0; i < 100; ++i) {
+    variant_encode(i % 2 == 0 ? V(i) : V(std::to_string(i)), encoded);
+  }
+  std::vector<std::string_view> chunks;
+  for (size_t pos = 0; pos < encoded.size(); pos += 5) {
+    chunks.push_back(std::string_view(encoded).substr(pos, 5));
+  }
+  int expected = 0;
+  for (auto& v : decode_stream<int, std::string>(chunks)) {
+    if (expected % 2 == 0) {
+      ASSERT_EQ(get<0>(v), expected);
+    } else {
+      ASSERT_EQ(get<1>(v), std::to_string(expected));
+    }
+    ++expected;
+  }
+  ASSERT_EQ(expected, 100);
+
+  chunks.pop_back();
+  ASSERT_THROW(
+      {
+        for ([[maybe_unused]] auto& v : decode_stream<int, std::string>(chunks)) {
+        }
+      },
+      stream_error);
+}
+
+namespace {
+struct fsm_idle {};
+struct fsm_connecting {
+  std::string host;
+  int attempts = 0;
+};
+struct fsm_connected {
+  size_t bytes = 0;
+};
+
+struct fsm_connect {
+  std::string host;
+};
+struct fsm_timeout {};
+struct fsm_data {
+  size_t size;
+};
+struct fsm_close {};
+
+struct fsm_transitions {
+  enter<fsm_connecting, std::string, int> operator()(fsm_idle&, const fsm_connect& e) const {
+    return enter_state<fsm_connecting>(e.host, 1);
+  }
+  void operator()(fsm_connecting& s, const fsm_timeout&) const {
+    ++s.attempts;
+  }
+  fsm_connected operator()(fsm_connecting&, const fsm_data& e) const {
+    return fsm_connected{e.size};
+  }
+  void operator()(fsm_connected& s, const fsm_data& e) const {
+    s.bytes += e.size;
+  }
+  template <typename State>
+  fsm_idle operator()(State&, const fsm_close&) const {
+    return {};
+  }
+};
+} // namespace
+
+TEST(state_machine, transitions) {
+  using states = variant<fsm_idle, fsm_connecting, fsm_connected>;
+  using events = variant<fsm_connect, fsm_timeout, fsm_data, fsm_close>;
+  auto machine = make_state_machine<states, events>(fsm_transitions{});
+  ASSERT_TRUE(machine.is<fsm_idle>());
+
+  machine.dispatch(events(fsm_timeout{}));
+  ASSERT_TRUE(machine.is<fsm_idle>());
+
+  machine.dispatch(events(fsm_connect{"example.org"}));
+  ASSERT_TRUE(machine.is<fsm_connecting>());
+  machine.dispatch(fsm_timeout{});
+  machine.dispatch(events(fsm_timeout{}));
+  ASSERT_EQ(get<fsm_connecting>(machine.state()).host, "example.org");
+  ASSERT_EQ(get<fsm_connecting>(machine.state()).attempts, 3);
+
+  machine.dispatch(fsm_data{10});
+  machine.dispatch(events(fsm_data{5}));
+  ASSERT_TRUE(machine.is<fsm_connected>());
+  ASSERT_EQ(get<fsm_connected>(machine.state()).bytes, 15);
+
+  machine.dispatch(fsm_connect{"ignored"});
+  ASSERT_TRUE(machine.is<fsm_connected>());
+  machine.dispatch(events(fsm_close{}));
+  ASSERT_TRUE(machine.is<fsm_idle>());
+}
+
+TEST(state_machine, generic_handler) {
+  struct counter {
+    int value = 0;
+  };
+  auto transitions = []<typename State, typename Event>(State& s, const Event&) {
+    if constexpr (std::is_same_v<State, counter>) {
+      ++s.value;
+    }
+  };
+  using states = variant<counter, char, short, int, long, long long, float, double, unsigned char, unsigned short,
+                         unsigned, unsigned long, unsigned long long, bool, signed char, long double, wchar_t>;
+  using events = variant<char, short, int, long, long long, float, double, unsigned char, unsigned short, unsigned,
+                         unsigned long, unsigned long long, bool, signed char, long double, wchar_t, char16_t>;
+  state_machine<states, events, decltype(transitions)> machine(transitions);
+  machine.dispatch(events(1.0));
+  machine.dispatch(events(char16_t(1)));
+  machine.dispatch(true);
+  ASSERT_EQ(get<counter>(machine.state()).value, 3);
+}
+
+TEST(queue, spsc_in_place) {
+  spsc_queue<int, std::string, std::vector<int>> queue(3);
+  ASSERT_EQ(queue.capacity(), 4);
+  ASSERT_TRUE(queue.empty());
+  ASSERT_TRUE(queue.try_emplace<0>(1));
+  ASSERT_TRUE(queue.try_emplace<std::string>(3, 'a'));
+  ASSERT_TRUE(queue.try_emplace<2>(std::vector<int>{1, 2}));
+  ASSERT_TRUE(queue.try_emplace<0>(4));
+  ASSERT_FALSE(queue.try_emplace<0>(5));
+
+  std::vector<std::string> seen;
+  auto record = [&seen]<typename T>(T& value) {
+    if constexpr (std::is_same_v<T, int>) {
+      seen.push_back(std::to_string(value));
+    } else if constexpr (std::is_same_v<T, std::string>) {
+      seen.push_back(std::move(value));
+    } else {
+      seen.push_back(std::to_string(value.size()));
+    }
+  };
+  ASSERT_TRUE(queue.try_consume(record));
+  ASSERT_TRUE(queue.try_consume(record));
+  ASSERT_TRUE(queue.try_emplace<1>("wrap"));
+  while (queue.try_consume(record)) {
+  }
+  ASSERT_EQ(seen, (std::vector<std::string>{"1", "aaa", "2", "4", "wrap"}));
+  ASSERT_TRUE(queue.empty());
+
+  queue.emplace<1>(100, 'x');
+  queue.emplace<1>(100, 'y');
+}
+
+TEST(queue, spsc_threads) {
+  constexpr uint64_t count = 200000;
+  spsc_queue<uint64_t, std::string> queue(64);
+  std::thread producer([&queue] {
+    for (uint64_t i = 0; i < count; ++i) {
+      if (i % 16 == 0) {
+        queue.emplace<1>(std::to_string(i));
+      } else {
+        queue.emplace<0>(i);
+      }
+    }
+  });
+  uint64_t sum = 0;
+  for (uint64_t i = 0; i < count; ++i) {
+    queue.consume([&sum]<typename T>(const T& value) {
+      if constexpr (std::is_same_v<T, std::string>) {
+        sum += std::stoull(value);
+      } else {
+        sum += value;
+      }
+    });
+  }
+  producer.join();
+  ASSERT_EQ(sum, count * (count - 1) / 2);
+  ASSERT_TRUE(queue.empty());
+}
+
+TEST(queue, mpmc_threads) {
+  constexpr uint64_t per_producer = 50000;
+  constexpr size_t threads = 4;
+  mpmc_queue<uint64_t, std::string> queue(128);
+  std::atomic<uint64_t> sum = 0;
+  std::atomic<uint64_t> consumed = 0;
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&queue] {
+      for (uint64_t i = 1; i <= per_producer; ++i) {
+        if (i % 8 == 0) {
+          queue.emplace<std::string>(std::to_string(i));
+        } else {
+          queue.emplace<uint64_t>(i);
+        }
+      }
+    });
+    workers.emplace_back([&] {
+      while (consumed.load() < threads * per_producer) {
+        if (queue.try_consume([&sum]<typename T>(const T& value) {
+              if constexpr (std::is_same_v<T, std::string>) {
+                sum += std::stoull(value);
+              } else {
+                sum += value;
+              }
+            })) {
+          ++consumed;
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  ASSERT_EQ(sum.load(), threads * per_producer * (per_producer + 1) / 2);
+  ASSERT_FALSE(queue.try_consume([](auto&) {}));
+}
+
+TEST(queue, mpmc_throwing_constructor) {
+  struct throwing {
+    explicit throwing(bool fail) {
+      if (fail) {
+        throw std::runtime_error("construction failed");
+      }
+    }
+  };
+  mpmc_queue<int, throwing> queue(4);
+  ASSERT_TRUE(queue.try_emplace<0>(1));
+  ASSERT_THROW(queue.try_emplace<throwing>(true), std::runtime_error);
+  ASSERT_TRUE(queue.try_emplace<throwing>(false));
+  std::vector<size_t> seen;
+  while (queue.try_consume([&seen]<typename T>(T&) { seen.push_back(std::is_same_v<T, int> ? 0 : 1); })) {
+  }
+  ASSERT_EQ(seen, (std::vector<size_t>{0, 1}));
+}
+
+TEST(hash_map, heterogeneous_lookup) {
+  using key = variant<int64_t, std::string, double>;
+  variant_hash_map<key, int> map;
+  ASSERT_TRUE(map.empty());
+  ASSERT_EQ(map.find(int64_t(1)), map.end());
+
+  ASSERT_TRUE(map.try_emplace(key(int64_t(1)), 10).second);
+  ASSERT_TRUE(map.try_emplace(std::string("one"), 11).second);
+  ASSERT_TRUE(map.try_emplace(1.0, 12).second);
+  ASSERT_FALSE(map.try_emplace(int64_t(1), 13).second);
+  ASSERT_EQ(map.size(), 3);
+
+  ASSERT_EQ(map.find(int64_t(1))->second, 10);
+  ASSERT_EQ(map.find(key(std::string("one")))->second, 11);
+  ASSERT_EQ(map.find(in_place_index<1>, std::string_view("one"))->second, 11);
+  ASSERT_EQ(map.at(1.0), 12);
+  ASSERT_FALSE(map.contains(int64_t(2)));
+  ASSERT_FALSE(map.contains(std::string("two")));
+  ASSERT_THROW(map.at(2.0), std::out_of_range);
+
+  map[std::string("two")] = 2;
+  map[key(int64_t(2))] += 5;
+  ASSERT_EQ(map.at(std::string("two")), 2);
+  ASSERT_EQ(map.at(int64_t(2)), 5);
+
+  ASSERT_EQ(map.erase(std::string("one")), 1);
+  ASSERT_EQ(map.erase(std::string("one")), 0);
+  ASSERT_EQ(map.count(std::string("one")), 0);
+  ASSERT_EQ(map.size(), 4);
+
+  int sum = 0;
+  for (const auto& [k, v] : map) {
+    sum += v;
+  }
+  ASSERT_EQ(sum, 10 + 12 + 2 + 5);
+}
+
+TEST(hash_map, growth_and_erase) {
+  using key = variant<int64_t, std::string>;
+  variant_hash_map<key, int64_t> map;
+  for (int64_t i = 0; i < 5000; ++i) {
+    if (i % 2 == 0) {
+      map.try_emplace(i, i);
+    } else {
+      map.try_emplace(std::to_string(i), i);
+    }
+  }
+  ASSERT_EQ(map.size(), 5000);
+  for (int64_t i = 0; i < 5000; ++i) {
+    auto it = i % 2 == 0 ? map.find(i) : map.find(std::to_string(i));
+    ASSERT_NE(it, map.end());
+    ASSERT_EQ(it->second, i);
+    ASSERT_FALSE(i % 2 == 0 ? map.contains(std::to_string(i)) : map.contains(i));
+  }
+
+  for (auto it = map.begin(); it != map.end();) {
+    it = it->second % 3 == 0 ? map.erase(it) : std::next(it);
+  }
+  ASSERT_EQ(map.size(), 5000 - 1667);
+
+  size_t capacity = map.capacity();
+  for (int round = 0; round < 10; ++round) {
+    for (int64_t i = 0; i < 1000; ++i) {
+      map.try_emplace(key(int64_t(-1 - i)), i);
+    }
+    for (int64_t i = 0; i < 1000; ++i) {
+      ASSERT_EQ(map.erase(int64_t(-1 - i)), 1);
+    }
+  }
+  ASSERT_EQ(map.capacity(), capacity);
+
+  auto copy = map;
+  ASSERT_EQ(copy.size(), map.size());
+  for (const auto& [k, v] : map) {
+    ASSERT_EQ(copy.at(k), v);
+  }
+  map.clear();
+  ASSERT_TRUE(map.empty());
+  ASSERT_FALSE(map.contains(int64_t(1)));
+  ASSERT_EQ(copy.at(std::string("1")), 1);
+}
+
+TEST(relops, alternative_value) {
+  using V = variant<int64_t, std::string, double>;
+  V i = int64_t(5);
+  V s = std::string("abc");
+  V d = 2.5;
+
+  ASSERT_TRUE(i == 5);
+  ASSERT_TRUE(5 == i);
+  ASSERT_TRUE(i != 6);
+  ASSERT_TRUE(i != 5.0);
+  ASSERT_TRUE(s == "abc");
+  ASSERT_TRUE("abd" != s);
+  ASSERT_TRUE(d == 2.5);
+
+  ASSERT_TRUE(i < 6);
+  ASSERT_TRUE(i <= 5);
+  ASSERT_TRUE(i > 4);
+  ASSERT_TRUE(i >= 5);
+  ASSERT_TRUE(4 < i);
+  ASSERT_TRUE(6 > i);
+  ASSERT_TRUE(5 <= i && 5 >= i);
+
+  ASSERT_TRUE(i < "a");
+  ASSERT_TRUE(s > 100);
+  ASSERT_TRUE(s < 0.0);
+  ASSERT_TRUE(1.0 > s);
+  ASSERT_TRUE(d > std::string("zzz"));
+  ASSERT_TRUE(std::string("zzz") < d);
+
+  for (V const& v : {i, s, d}) {
+    for (V const& w : {V(int64_t(4)), V(int64_t(5)), V(std::string("abc")), V(std::string("b")), V(1.0)}) {
+      visit(
+          [&v](auto const& value) {
+            V promoted = value;
+            ASSERT_EQ(v == value, v == promoted);
+            ASSERT_EQ(v < value, v < promoted);
+            ASSERT_EQ(v > value, v > promoted);
+            ASSERT_EQ(v <= value, v <= promoted);
+            ASSERT_EQ(v >= value, v >= promoted);
+            ASSERT_EQ(value < v, promoted < v);
+            ASSERT_EQ(value > v, promoted > v);
+            ASSERT_EQ(value <= v, promoted <= v);
+            ASSERT_EQ(value >= v, promoted >= v);
+          },
+          w);
+    }
+  }
+
+  using W = variant<int, throwing_move_operator_t>;
+  W valueless = 1;
+  ASSERT_ANY_THROW({
+    W tmp(in_place_index<1>);
+    valueless = std::move(tmp);
+  });
+  ASSERT_TRUE(valueless.valueless_by_exception());
+  ASSERT_FALSE(valueless == 1);
+  ASSERT_TRUE(valueless < 1 && valueless <= 1);
+  ASSERT_FALSE(valueless > 1 || valueless >= 1);
+  ASSERT_TRUE(1 > valueless && 1 >= valueless);
+  ASSERT_FALSE(1 < valueless || 1 <= valueless);
+
+  std::set<V, std::less<>> set{i, s, d, V(int64_t(7))};
+  ASSERT_NE(set.find(7), set.end());
+  ASSERT_EQ(set.find(8), set.end());
+  ASSERT_NE(set.find("abc"), set.end());
+  ASSERT_EQ(std::distance(set.lower_bound(6), set.upper_bound("zzz")), 2);
+}
+
+namespace constant_init {
+struct point {
+  int x;
+  int y;
+};
+
+struct literal {
+  constexpr literal(int v) : value(v) {}
+  constexpr literal(const literal& other) : value(other.value) {}
+  constexpr literal& operator=(const literal& other) {
+    value = other.value;
+    return *this;
+  }
+  constexpr ~literal() {}
+
+  int value;
+};
+
+using cell = variant<int, double, std::string_view, point>;
+
+template <size_t... I>
+constexpr std::array<cell, sizeof...(I)> make_cells(std::index_sequence<I...>) {
+  return {(I % 4 == 0   ? cell(int(I))
+           : I % 4 == 1 ? cell(double(I) / 2)
+           : I % 4 == 2 ? cell(std::string_view("cell"))
+                        : cell(in_place_type<point>, point{int(I), -int(I)}))...};
+}
+
+constinit cell converting = 42;
+constinit cell by_index(in_place_index<3>, point{1, 2});
+constinit cell by_type(in_place_type<std::string_view>, "abc");
+constexpr cell source = 2.5;
+constinit cell copied = source;
+constinit cell moved = cell(1.5);
+constinit variant<std::string, int> non_trivial = 7;
+constinit variant<std::string, int> non_trivial_default;
+constinit variant<literal, int> non_trivial_literal(in_place_index<0>, 3);
+constexpr auto cells = make_cells(std::make_index_sequence<4096>());
+constinit std::array<cell, 4096> cells_copy = cells;
+
+constexpr auto assigned = [] {
+  std::array<cell, 256> result{};
+  for (size_t i = 0; i < result.size(); ++i) {
+    if (i % 2 == 0) {
+      result[i] = double(i);
+    } else {
+      result[i].emplace<point>(point{int(i), 0});
+    }
+  }
+  return result;
+}();
+
+constexpr int sum_x(const cell& c) {
+  return visit(
+      [](const auto& value) {
+        if constexpr (std::is_same_v<std::decay_t<decltype(value)>, point>) {
+          return value.x;
+        } else {
+          return 0;
+        }
+      },
+      c);
+}
+
+constexpr bool non_trivial_paths() {
+  variant<literal, int> v(literal(3));
+  variant<literal, int> w = v;
+  w = 5;
+  w = v;
+  variant<literal, int> m = std::move(w);
+  m.emplace<0>(9);
+  m.swap(v);
+  return get<0>(m).value == 3 && get<0>(v).value == 9;
+}
+
+constexpr bool two_variant_visit() {
+  cell a = 1;
+  cell b(in_place_type<point>, point{2, 3});
+  return visit([](const auto& l, const auto& r) { return sizeof(l) + sizeof(r); }, a, b) == sizeof(int) + sizeof(point);
+}
+
+static_assert(cells[4].index() == 0 && get<0>(cells[4]) == 4);
+static_assert(cells[4095].index() == 3 && get<3>(cells[4095]).y == -4095);
+static_assert(cells[2] == std::string_view("cell"));
+static_assert(assigned[10] == 10.0 && sum_x(assigned[11]) == 11);
+static_assert(non_trivial_paths());
+static_assert(two_variant_visit());
+} // namespace constant_init
+
+TEST(constant_init, static_tables) {
+  using namespace constant_init;
+  ASSERT_EQ(converting, 42);
+  ASSERT_EQ(get<point>(by_index).y, 2);
+  ASSERT_EQ(by_type, std::string_view("abc"));
+  ASSERT_EQ(copied, 2.5);
+  ASSERT_EQ(moved, 1.5);
+  ASSERT_EQ(non_trivial, 7);
+  ASSERT_EQ(get<0>(non_trivial_default), "");
+  ASSERT_EQ(get<0>(non_trivial_literal).value, 3);
+  ASSERT_EQ(cells_copy[2], std::string_view("cell"));
+  int total = 0;
+  for (const cell& c : cells_copy) {
+    total += sum_x(c);
+  }
+  ASSERT_EQ(total, 1024 * (3 + 4095) / 2);
+}
+
+namespace conformance {
+struct throwing_copy_t {
+  throwing_copy_t() = default;
+  throwing_copy_t(const throwing_copy_t&) noexcept(false) {}
+  throwing_copy_t(throwing_copy_t&&) noexcept = default;
+  throwing_copy_t& operator=(const throwing_copy_t&) noexcept(false) {
+    return *this;
+  }
+  throwing_copy_t& operator=(throwing_copy_t&&) noexcept = default;
+};
+
+struct trivial_move_user_dtor_t {
+  trivial_move_user_dtor_t() = default;
+  trivial_move_user_dtor_t(const trivial_move_user_dtor_t&) = default;
+  trivial_move_user_dtor_t(trivial_move_user_dtor_t&&) = default;
+  trivial_move_user_dtor_t& operator=(const trivial_move_user_dtor_t&) = default;
+  trivial_move_user_dtor_t& operator=(trivial_move_user_dtor_t&&) = default;
+  ~trivial_move_user_dtor_t() {}
+};
+
+struct from_int_t {
+  from_int_t(int) noexcept {}
+};
+
+struct throwing_from_int_t {
+  throwing_from_int_t(int) noexcept(false) {}
+};
+
+template <typename Ours, typename Theirs>
+constexpr bool special_members_match() {
+  static_assert(std::is_default_constructible_v<Ours> == std::is_default_constructible_v<Theirs>);
+  static_assert(std::is_nothrow_default_constructible_v<Ours> == std::is_nothrow_default_constructible_v<Theirs>);
+  static_assert(std::is_copy_constructible_v<Ours> == std::is_copy_constructible_v<Theirs>);
+  static_assert(std::is_nothrow_copy_constructible_v<Ours> == std::is_nothrow_copy_constructible_v<Theirs>);
+  static_assert(std::is_trivially_copy_constructible_v<Ours> == std::is_trivially_copy_constructible_v<Theirs>);
+  static_assert(std::is_move_constructible_v<Ours> == std::is_move_constructible_v<Theirs>);
+  static_assert(std::is_nothrow_move_constructible_v<Ours> == std::is_nothrow_move_constructible_v<Theirs>);
+  static_assert(std::is_trivially_move_constructible_v<Ours> == std::is_trivially_move_constructible_v<Theirs>);
+  static_assert(std::is_copy_assignable_v<Ours> == std::is_copy_assignable_v<Theirs>);
+  static_assert(std::is_nothrow_copy_assignable_v<Ours> == std::is_nothrow_copy_assignable_v<Theirs>);
+  static_assert(std::is_trivially_copy_assignable_v<Ours> == std::is_trivially_copy_assignable_v<Theirs>);
+  static_assert(std::is_move_assignable_v<Ours> == std::is_move_assignable_v<Theirs>);
+  static_assert(std::is_nothrow_move_assignable_v<Ours> == std::is_nothrow_move_assignable_v<Theirs>);
+  static_assert(std::is_trivially_move_assignable_v<Ours> == std::is_trivially_move_assignable_v<Theirs>);
+  static_assert(std::is_trivially_destructible_v<Ours> == std::is_trivially_destructible_v<Theirs>);
+  static_assert(std::is_nothrow_swappable_v<Ours> == std::is_nothrow_swappable_v<Theirs>);
+  static_assert(std::is_trivially_copyable_v<Ours> == std::is_trivially_copyable_v<Theirs>);
+  return true;
+}
+
+template <typename... Types>
+inline constexpr bool matches_std = special_members_match<variant<Types...>, std::variant<Types...>>();
+
+template <typename From, typename... Types>
+inline constexpr bool converting_matches_std =
+    std::is_nothrow_constructible_v<variant<Types...>, From> ==
+        std::is_nothrow_constructible_v<std::variant<Types...>, From> &&
+    std::is_nothrow_assignable_v<variant<Types...>&, From> ==
+        std::is_nothrow_assignable_v<std::variant<Types...>&, From>;
+
+static_assert(matches_std<int>);
+static_assert(matches_std<int, double, char>);
+static_assert(matches_std<std::string>);
+static_assert(matches_std<int, std::string>);
+static_assert(matches_std<std::vector<int>, std::string>);
+static_assert(matches_std<std::unique_ptr<int>, int>);
+static_assert(matches_std<int, throwing_copy_t>);
+static_assert(matches_std<int, throwing_move_operator_t>);
+static_assert(matches_std<int, throwing_move_assignment_t>);
+static_assert(matches_std<throwing_default_t, int>);
+static_assert(matches_std<non_trivial_copy_t, int>);
+static_assert(matches_std<int, non_trivial_copy_assignment_t>);
+static_assert(matches_std<int, no_copy_t>);
+static_assert(matches_std<no_move_t, int>);
+static_assert(matches_std<int, no_move_assignment_t>);
+static_assert(matches_std<int, no_copy_assignment_t>);
+static_assert(matches_std<only_movable, int>);
+static_assert(matches_std<trivial_move_user_dtor_t, int>);
+static_assert(matches_std<int, std::string, trivial_move_user_dtor_t>);
+
+static_assert(converting_matches_std<int, from_int_t, std::string>);
+static_assert(converting_matches_std<int, throwing_from_int_t, double*>);
+static_assert(converting_matches_std<const char*, std::string, int>);
+static_assert(converting_matches_std<std::string&&, std::string, int>);
+static_assert(converting_matches_std<const std::string&, std::string, int>);
+} // namespace conformance
+
+TEST(conformance, vector_reallocation_moves) {
+  struct counted {
+    counted() = default;
+    counted(const counted& other) : copies(other.copies + 1) {}
+    counted(counted&& other) noexcept = default;
+    counted& operator=(const counted&) = default;
+    counted& operator=(counted&&) noexcept = default;
+
+    int copies = 0;
+  };
+  std::vector<variant<int, counted>> values;
+  for (int i = 0; i < 1000; ++i) {
+    values.emplace_back(in_place_type<counted>);
+  }
+  values.insert(values.begin(), variant<int, counted>(1));
+  values.erase(values.begin());
+  for (const auto& v : values) {
+    ASSERT_EQ(get<counted>(v).copies, 0);
+  }
+}
+
+namespace register_abi {
+template <typename... Types>
+constexpr bool register_passable =
+    std::is_trivially_copyable_v<variant<Types...>> && sizeof(variant<Types...>) <= 2 * sizeof(void*);
+
+static_assert(sizeof(variant<char>) == 2);
+static_assert(sizeof(variant<int, float>) == 8);
+static_assert(sizeof(variant<int, float>) == sizeof(std::variant<int, float>));
+static_assert(sizeof(variant<int64_t, double>) == 16);
+static_assert(sizeof(variant<int, double*>) == 16);
+
+static_assert(register_passable<int, float>);
+static_assert(register_passable<int64_t, double>);
+static_assert(register_passable<char, short, int, int*>);
+struct point {
+  int x;
+  int y;
+};
+
+static_assert(register_passable<point, int64_t>);
+static_assert(!register_passable<int, std::string>);
+
+static_assert(std::is_same_v<details::variant_index_t<2>, uint8_t>);
+static_assert(std::is_same_v<details::variant_index_t<254>, uint8_t>);
+static_assert(std::is_same_v<details::variant_index_t<255>, uint16_t>);
+} // namespace register_abi
+
+TEST(abi, small_index) {
+  variant<int, throwing_default_t> v = 3;
+  ASSERT_EQ(v.index(), 0);
+  ASSERT_THROW(v.emplace<throwing_default_t>(), std::exception);
+  ASSERT_TRUE(v.valueless_by_exception());
+  ASSERT_EQ(v.index(), variant_npos);
+  v = 4;
+  ASSERT_EQ(v.index(), 0);
+  constexpr variant<char, int> w(in_place_index<1>, 5);
+  static_assert(w.index() == 1);
+}
+
+namespace {
+template <typename T>
+task<T> after_hops(event_loop& loop, int hops, T value, int* finished = nullptr) {
+  for (int i = 0; i < hops; ++i) {
+    co_await loop.schedule();
+  }
+  if (finished != nullptr) {
+    ++*finished;
+  }
+  co_return value;
+}
+
+task<void> hop(event_loop& loop) {
+  co_await loop.schedule();
+}
+
+task<int> fail_after(event_loop& loop, int hops) {
+  for (int i = 0; i < hops; ++i) {
+    co_await loop.schedule();
+  }
+  throw std::runtime_error("failed");
+}
+
+task<int> add(event_loop& loop, int a, int b) {
+  co_return co_await after_hops(loop, 1, a) + co_await after_hops(loop, 2, b);
+}
+
+template <typename... Awaitables>
+task<size_t> race_index(Awaitables... operands) {
+  auto result = co_await when_any(std::move(operands)...);
+  co_return result.index();
+}
+
+// Moves once into when_any and throws on the move that would hand it to its entrant.
+struct fragile_awaitable {
+  explicit fragile_awaitable(int* moves) : moves(moves) {}
+
+  fragile_awaitable(fragile_awaitable&& other) : moves(other.moves) {
+    if (++*moves > 1) {
+      throw std::runtime_error("fragile");
+    }
+  }
+
+  bool await_ready() const noexcept {
+    return true;
+  }
+
+  void await_suspend(std::coroutine_handle<>) const noexcept {}
+
+  int await_resume() const noexcept {
+    return 0;
+  }
+
+  int* moves;
+};
+
+task<int> race_fragile(event_loop& loop, int* finished, int* moves) {
+  try {
+    co_await when_any(after_hops(loop, 2, 1, finished), fragile_awaitable(moves));
+  } catch (const std::runtime_error&) {
+    co_return -1;
+  }
+  co_return 0;
+}
+} // namespace
+
+TEST(task, chain) {
+  event_loop loop;
+  ASSERT_EQ(loop.run(add(loop, 2, 3)), 5);
+  ASSERT_THROW(loop.run(fail_after(loop, 2)), std::runtime_error);
+}
+
+TEST(task, when_any_first_wins) {
+  event_loop loop;
+  int finished = 0;
+  auto race = [&]() -> task<variant<int, std::string, void_result>> {
+    co_return co_await when_any(after_hops(loop, 3, 1, &finished), after_hops(loop, 1, std::string("fast"), &finished),
+                                hop(loop));
+  };
+  auto result = loop.run(race());
+  ASSERT_EQ(result.index(), 1);
+  ASSERT_EQ(get<1>(result), "fast");
+  ASSERT_EQ(finished, 2);
+
+  ASSERT_EQ(loop.run(race_index(hop(loop), after_hops(loop, 0, 1))), 1);
+  ASSERT_THROW(loop.run(race_index(after_hops(loop, 2, 1), fail_after(loop, 1))), std::runtime_error);
+}
+
+TEST(task, when_any_ready_operand) {
+  event_loop loop;
+  int finished = 0;
+  auto result =
+      loop.run(race_index(after_hops(loop, 0, 1, &finished), after_hops(loop, 0, 2, &finished), hop(loop)));
+  ASSERT_EQ(result, 0);
+  ASSERT_EQ(finished, 1);
+}
+
+TEST(task, when_any_start_failure) {
+  event_loop loop;
+  int finished = 0;
+  int moves = 0;
+  // The racing coroutine's frame, and the race state in it, are gone before the started entrant finishes.
+  auto outer = [&]() -> task<int> { co_return co_await race_fragile(loop, &finished, &moves); };
+  ASSERT_EQ(loop.run(outer()), -1);
+  ASSERT_EQ(finished, 1);
+}
+
+namespace expected_layout {
+static_assert(sizeof(expected<int, int>) == 8);
+static_assert(sizeof(expected<char, bool>) == 2);
+static_assert(std::is_same_v<details::variant_index_t<2>, uint8_t>);
+static_assert(std::is_trivially_copyable_v<expected<int, double>>);
+static_assert(std::is_trivially_destructible_v<expected<int, double>>);
+static_assert(!std::is_trivially_destructible_v<expected<std::string, int>>);
+static_assert(std::is_nothrow_move_constructible_v<expected<std::string, std::vector<int>>>);
+static_assert(!std::is_copy_constructible_v<expected<only_movable, int>>);
+
+constexpr int constexpr_chain() {
+  expected<int, int> e = 20;
+  auto r = e.transform([](int x) { return x + 1; }).and_then([](int x) -> expected<int, int> {
+    if (x > 10) {
+      return unexpected(x);
+    }
+    return x;
+  });
+  return r.has_value() ? 0 : r.error();
+}
+
+static_assert(constexpr_chain() == 21);
+} // namespace expected_layout
+
+namespace {
+expected<int, std::string> parse_digit(char c) {
+  if (c < '0' || c > '9') {
+    return unexpected(std::string("not a digit: ") + c);
+  }
+  return c - '0';
+}
+} // namespace
+
+TEST(expected, access) {
+  auto good = parse_digit('7');
+  ASSERT_TRUE(good.has_value());
+  ASSERT_EQ(*good, 7);
+  ASSERT_EQ(good.value(), 7);
+  ASSERT_TRUE(good == 7);
+
+  auto bad = parse_digit('x');
+  ASSERT_FALSE(bad);
+  ASSERT_EQ(bad.error(), "not a digit: x");
+  ASSERT_TRUE(bad == unexpected(std::string("not a digit: x")));
+  ASSERT_THROW(static_cast<void>(bad.value()), bad_variant_access);
+  ASSERT_EQ(bad.value_or(-1), -1);
+
+  expected<std::string, int> in_place_value(in_place, 3, 'a');
+  ASSERT_EQ(*in_place_value, "aaa");
+  ASSERT_EQ(in_place_value->size(), 3);
+  expected<std::string, int> in_place_error(unexpect, 5);
+  ASSERT_EQ(in_place_error.error(), 5);
+}
+
+TEST(expected, monadic) {
+  auto twice = [](int x) -> expected<int, std::string> { return x * 2; };
+  ASSERT_EQ(*parse_digit('4').and_then(twice), 8);
+  ASSERT_EQ(parse_digit('?').and_then(twice).error(), "not a digit: ?");
+
+  auto text = parse_digit('3').transform([](int x) { return std::to_string(x) + "!"; });
+  static_assert(std::is_same_v<decltype(text), expected<std::string, std::string>>);
+  ASSERT_EQ(*text, "3!");
+
+  auto length = parse_digit('z').transform_error([](const std::string& s) { return s.size(); });
+  static_assert(std::is_same_v<decltype(length), expected<int, size_t>>);
+  ASSERT_EQ(length.error(), 14);
+
+  auto recovered = parse_digit('z').or_else([](const std::string&) -> expected<int, std::string> { return 0; });
+  ASSERT_EQ(*recovered, 0);
+
+  expected<only_movable, int> movable;
+  auto moved = std::move(movable).transform([](only_movable&& m) { return only_movable(std::move(m)); });
+  ASSERT_TRUE(moved.has_value());
+}
+
+TEST(expected, assignment_and_swap) {
+  expected<std::string, std::vector<int>> a = std::string("value");
+  expected<std::string, std::vector<int>> b(unexpect, 3, 1);
+  auto c = a;
+  ASSERT_EQ(*c, "value");
+  c = b;
+  ASSERT_EQ(c.error().size(), 3);
+  c = std::string("again");
+  ASSERT_EQ(*c, "again");
+  c = unexpected(std::vector<int>{1, 2});
+  ASSERT_EQ(c.error().size(), 2);
+  c = std::move(a);
+  ASSERT_EQ(*c, "value");
+
+  swap(c, b);
+  ASSERT_EQ(b.value(), "value");
+  ASSERT_EQ(c.error().size(), 3);
+  c.emplace(2, 'z');
+  ASSERT_EQ(*c, "zz");
+}
+
+TEST(expected, variant_interop) {
+  using V = variant<int, std::string>;
+  expected<int, std::string> from_value(V(5));
+  ASSERT_EQ(*from_value, 5);
+  V v = std::string("oops");
+  expected<int, std::string> from_error(v);
+  ASSERT_EQ(from_error.error(), "oops");
+  ASSERT_TRUE(from_error.to_variant() == v);
+  ASSERT_EQ(get<0>(from_value.to_variant()), 5);
+}
+
+TEST(shared_variant, copies_share_storage) {
+  using V = shared_variant<int, std::string, std::vector<int>>;
+  V a(in_place_index<2>, 1000, 7);
+  V b = a;
+  const V c = b;
+  ASSERT_TRUE(a.shares_storage_with(c));
+  ASSERT_EQ(a.use_count(), 3);
+  ASSERT_EQ(get<2>(c).size(), 1000);
+  ASSERT_EQ(visit([](const auto& x) { return sizeof(x); }, c), sizeof(std::vector<int>));
+  ASSERT_TRUE(holds_alternative<std::vector<int>>(c));
+  ASSERT_NE(get_if<2>(&c), nullptr);
+  ASSERT_EQ(get_if<int>(&c), nullptr);
+  ASSERT_THROW(static_cast<void>(get<std::string>(c)), bad_variant_access);
+  ASSERT_EQ(a.use_count(), 3);
+  ASSERT_TRUE(a == c);
+}
+
+TEST(shared_variant, copy_on_write) {
+  using V = shared_variant<int, std::string>;
+  V a = std::string("shared");
+  V b = a;
+  ASSERT_THROW(static_cast<void>(get<int>(b)), bad_variant_access);
+  ASSERT_TRUE(a.shares_storage_with(b));
+
+  get<std::string>(b) += "!";
+  ASSERT_FALSE(a.shares_storage_with(b));
+  ASSERT_EQ(get<1>(std::as_const(a)), "shared");
+  ASSERT_EQ(get<1>(std::as_const(b)), "shared!");
+  ASSERT_EQ(a.use_count(), 1);
+  ASSERT_TRUE(a < b);
+
+  V c = a;
+  c.emplace<0>(5);
+  ASSERT_EQ(get<1>(std::as_const(a)), "shared");
+  ASSERT_EQ(get<0>(std::as_const(c)), 5);
+  ASSERT_TRUE(c < a);
+  c.emplace<int>(6);
+  ASSERT_EQ(get<int>(std::as_const(c)), 6);
+
+  c.mutate() = std::string("replaced");
+  ASSERT_TRUE((*c == variant<int, std::string>(std::string("replaced"))));
+
+  V moved = std::move(c);
+  ASSERT_TRUE(c.valueless_by_exception());  // NOLINT(bugprone-use-after-move)
+  ASSERT_TRUE(c < moved);
+  ASSERT_TRUE(c != moved);
+  std::string taken = get<1>(std::move(moved));
+  ASSERT_EQ(taken, "replaced");
+}
+
+TEST(shared_variant, concurrent_copies) {
+  shared_variant<int, std::vector<int>> message(in_place_index<1>, 100, 1);
+  std::vector<std::thread> subscribers;
+  for (int t = 0; t < 4; ++t) {
+    subscribers.emplace_back([&message] {
+      for (int i = 0; i < 10000; ++i) {
+        auto copy = message;
+        ASSERT_EQ(get<1>(std::as_const(copy)).size(), 100);
+      }
+    });
+  }
+  for (auto& subscriber : subscribers) {
+    subscriber.join();
+  }
+  ASSERT_EQ(message.use_count(), 1);
+}
+
+TEST(variant_pool, interning) {
+  variant_pool<int, std::string, long> pool;
+  using handle = decltype(pool)::handle;
+  static_assert(sizeof(handle) == 8);
+
+  handle a = pool.intern(std::string("symbol"));
+  handle b = pool.intern(variant<int, std::string, long>(std::string("symbol")));
+  handle c = pool.intern(std::string("other"));
+  handle d = pool.intern(7);
+  ASSERT_EQ(a, b);
+  ASSERT_NE(a, c);
+  ASSERT_EQ(a.index(), 1);
+  ASSERT_EQ(d.index(), 0);
+  ASSERT_EQ(std::hash<handle>{}(a), std::hash<handle>{}(b));
+  ASSERT_EQ(pool.intern(in_place_index<1>, "symbol"), a);
+  ASSERT_EQ(pool.intern(in_place_index<2>, 7), pool.intern(7L));
+  ASSERT_NE(pool.intern(in_place_index<2>, 7), d);
+  ASSERT_EQ(pool.size<1>(), 2);
+  ASSERT_EQ(pool.size(), 4);
+
+  ASSERT_EQ(pool.get<1>(a), "symbol");
+  ASSERT_EQ(pool.get<int>(d), 7);
+  ASSERT_THROW(static_cast<void>(pool.get<0>(a)), bad_variant_access);
+  ASSERT_THROW(static_cast<void>(pool[handle()]), bad_variant_access);
+  ASSERT_EQ(get<std::string>(pool[c]), "other");
+  ASSERT_EQ(visit([](const auto& value) { return sizeof(value); }, pool[d]), sizeof(int));
+  ASSERT_TRUE((pool[a] == variant_cref<int, std::string, long>(get<1>(pool[b]))));
+
+  std::vector<handle> handles;
+  for (int i = 0; i < 1000; ++i) {
+    handles.push_back(pool.intern(long(i % 100)));
+  }
+  ASSERT_EQ(pool.size<2>(), 100);
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_EQ(handles[i], handles[i % 100]);
+    ASSERT_EQ(pool.get<2>(handles[i]), i % 100);
+  }
+}
+
+TEST(variant_pool, concurrent_interning) {
+  variant_pool<int, std::string> pool;
+  using handle = decltype(pool)::handle;
+  constexpr int threads = 4;
+  constexpr int values = 5000;
+  std::vector<std::vector<handle>> results(threads);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&pool, &results, t] {
+      for (int i = 0; i < values; ++i) {
+        int v = (i * (t + 1)) % values;
+        results[t].push_back(v % 2 == 0 ? pool.intern(v) : pool.intern(std::to_string(v)));
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  ASSERT_EQ(pool.size(), values);
+  for (int t = 0; t < threads; ++t) {
+    for (int i = 0; i < values; ++i) {
+      int v = (i * (t + 1)) % values;
+      handle expected_handle = v % 2 == 0 ? pool.intern(v) : pool.intern(std::to_string(v));
+      ASSERT_EQ(results[t][i], expected_handle);
+    }
+  }
+}
+
+TEST(versioned_variant, version_bumps) {
+  using V = versioned_variant<int, std::string>;
+  V v = 1;
+  ASSERT_EQ(v.version(), 0);
+  const V& cv = v;
+  ASSERT_EQ(get<0>(cv), 1);
+  ASSERT_EQ(visit([](const auto& x) { return sizeof(x); }, cv), sizeof(int));
+  ASSERT_TRUE(holds_alternative<int>(cv));
+  ASSERT_NE(get_if<int>(&cv), nullptr);
+  ASSERT_EQ(v.version(), 0);
+
+  v = 2;
+  ASSERT_EQ(v.version(), 1);
+  v.emplace<std::string>("text");
+  ASSERT_EQ(v.version(), 2);
+  get<1>(v) += "!";
+  ASSERT_EQ(v.version(), 3);
+  ASSERT_THROW(static_cast<void>(get<0>(v)), bad_variant_access);
+  ASSERT_EQ(v.version(), 3);
+  ASSERT_EQ(get_if<0>(&v), nullptr);
+  ASSERT_EQ(v.version(), 3);
+
+  V other = 5;
+  swap(v, other);
+  ASSERT_EQ(v.version(), 4);
+  ASSERT_EQ(other.version(), 1);
+  ASSERT_EQ(get<int>(cv), 5);
+  ASSERT_EQ(get<std::string>(std::as_const(other)), "text!");
+  ASSERT_FALSE(v.modify([](auto&) { return false; }));
+  ASSERT_EQ(v.version(), 4);
+  v.modify([](auto& value) { value = 9; });
+  ASSERT_EQ(v.version(), 5);
+  ASSERT_TRUE(v == V(9));
+  ASSERT_TRUE(v < other);
+}
+
+TEST(versioned_variant, subscriptions_and_cache) {
+  versioned_variant<int, std::string> v = std::string("abc");
+  std::vector<uint64_t> seen;
+  size_t id = v.subscribe([&seen](const variant<int, std::string>& value, uint64_t version) {
+    seen.push_back(version);
+    ASSERT_FALSE(value.valueless_by_exception());
+  });
+  v = 3;
+  v.emplace<1>("xy");
+  v.modify([](auto& value) { get<1>(value) += "z"; });
+  ASSERT_EQ(seen, (std::vector<uint64_t>{1, 2, 3}));
+  ASSERT_TRUE(v.unsubscribe(id));
+  ASSERT_FALSE(v.unsubscribe(id));
+  v = 4;
+  ASSERT_EQ(seen.size(), 3);
+
+  int computations = 0;
+  version_cache<size_t> cache;
+  auto weight = [&computations](const variant<int, std::string>& value) {
+    ++computations;
+    return visit([](const auto& x) { return sizeof(x); }, value);
+  };
+  ASSERT_EQ(cache.get(v, weight), sizeof(int));
+  ASSERT_EQ(cache.get(v, weight), sizeof(int));
+  ASSERT_EQ(computations, 1);
+  v.emplace<1>("changed");
+  ASSERT_EQ(cache.get(v, weight), sizeof(std::string));
+  ASSERT_EQ(computations, 2);
+  cache.invalidate();
+  static_cast<void>(cache.get(v, weight));
+  ASSERT_EQ(computations, 3);
+}
+
+TEST(versioned_variant, cache_after_address_reuse) {
+  using V = versioned_variant<int, std::string>;
+  static_assert(!std::is_nothrow_move_assignable_v<V>);
+  std::optional<V> slot(std::in_place, 1);
+  version_cache<size_t> cache;
+  auto weight = [](const variant<int, std::string>& value) {
+    return visit([](const auto& x) { return sizeof(x); }, value);
+  };
+  ASSERT_EQ(cache.get(*slot, weight), sizeof(int));
+  uint64_t first = slot->id();
+  slot.emplace(std::string("same address, same version"));
+  ASSERT_NE(slot->id(), first);
+  ASSERT_EQ(slot->version(), 0);
+  ASSERT_EQ(cache.get(*slot, weight), sizeof(std::string));
+
+  V v = 1;
+  v.subscribe([](const variant<int, std::string>&, uint64_t) { throw std::runtime_error("subscriber"); });
+  ASSERT_THROW(v = V(2), std::runtime_error);
+  ASSERT_EQ(get<0>(std::as_const(v)), 2);
+}
+
+namespace common_layout {
+struct header {
+  uint32_t length = 0;
+  uint16_t kind = 0;
+};
+
+struct tag {
+  char name[5] = "tag";
+};
+
+struct ping : header {
+  uint64_t token = 1;
+};
+
+// The header sits after another base, so its offset differs from ping's.
+struct data : tag, header {
+  std::string payload;
+};
+
+struct mirrored : virtual header {};
+
+struct wire_a {
+  uint64_t id = 0;
+  header head;
+};
+
+struct wire_b {
+  header head;
+  std::vector<int> rest;
+};
+
+template <typename Base, typename V>
+concept has_common = requires(V& v) { as_common<Base>(v); };
+
+template <typename V, typename F>
+concept has_common_member = requires(V& v, F f) { common_member(v, f); };
+
+constexpr bool common_in_constexpr() {
+  variant<ping, header> v(in_place_index<0>);
+  as_common<header>(v).length = 12;
+  return as_common<header>(std::as_const(v)).length == 12 &&
+         common_member(v, [](auto& value) -> uint16_t& { return value.kind; }) == 0;
+}
+
+static_assert(common_in_constexpr());
+} // namespace common_layout
+
+TEST(as_common, base_at_different_offsets) {
+  using namespace common_layout;
+  using V = variant<ping, data, header>;
+  static_assert(has_common<header, V> && !has_common<tag, V> && !has_common<ping, V>);
+  V v(in_place_index<1>);
+  get<1>(v).payload = "abc";
+  header& h = as_common<header>(v);
+  ASSERT_EQ(&h, static_cast<header*>(get_if<1>(&v)));
+  h.length = 3;
+  ASSERT_EQ(get<1>(v).length, 3);
+  ASSERT_EQ(&as_common<header>(v), &h);
+
+  v.emplace<0>();
+  get<0>(v).kind = 7;
+  const V& cv = v;
+  ASSERT_EQ(as_common<header>(cv).kind, 7);
+  ASSERT_EQ(&as_common<header>(cv), static_cast<const header*>(get_if<0>(&cv)));
+
+  V other(in_place_index<1>);
+  get<1>(other).length = 9;
+  ASSERT_EQ(as_common<header>(other).length, 9);
+  v = header{5, 6};
+  ASSERT_EQ(as_common<header>(v).length, 5);
+}
+
+TEST(as_common, virtual_base_and_valueless) {
+  using namespace common_layout;
+  variant<mirrored, ping> v(in_place_index<0>);
+  as_common<header>(v).kind = 4;
+  ASSERT_EQ(get<0>(v).kind, 4);
+  ASSERT_EQ(&as_common<header>(v), static_cast<header*>(get_if<0>(&v)));
+
+  variant<ping, data> w;
+  ASSERT_THROW(w.emplace_with<1>([]() -> data { throw std::exception(); }), std::exception);
+  ASSERT_THROW(static_cast<void>(as_common<header>(w)), bad_variant_access);
+}
+
+TEST(common_member, projects_a_shared_field) {
+  using namespace common_layout;
+  variant<wire_a, wire_b> v(in_place_index<1>);
+  auto head = [](auto& value) -> auto& { return value.head; };
+  common_member(v, head).length = 21;
+  ASSERT_EQ(get<1>(v).head.length, 21);
+  v.emplace<0>().head.kind = 2;
+  ASSERT_EQ(&common_member(v, head), &get<0>(v).head);
+  ASSERT_EQ(common_member(std::as_const(v), head).kind, 2);
+  ASSERT_EQ(common_member(v, head).kind, 2);
+}
+
+TEST(common_member, distinct_projections_of_one_type) {
+  using namespace common_layout;
+  using V = variant<ping, data>;
+  static_assert(!has_common_member<V, decltype(std::mem_fn(&header::length))>);
+  V v(in_place_index<1>);
+  get<1>(v).length = 3;
+  get<1>(v).kind = 4;
+  ASSERT_EQ(common_member(v, [](header& h) -> auto& { return h.length; }), 3);
+  ASSERT_EQ(common_member(v, [](header& h) -> auto& { return h.kind; }), 4);
+  ASSERT_EQ(&common_member(v, [](header& h) -> auto& { return h.kind; }), &get<1>(v).kind);
+}
+
+namespace flat_layout {
+using inner1 = variant<int, std::string>;
+using inner2 = variant<double, std::vector<int>>;
+using nested = variant<inner1, inner2, char>;
+using deep = variant<variant<variant<int, long>, short>, char>;
+
+static_assert(std::is_same_v<flat_variant_t<nested>, variant<int, std::string, double, std::vector<int>, char>>);
+static_assert(std::is_same_v<flat_variant_t<deep>, variant<int, long, short, char>>);
+static_assert(flat_index_v<nested, 1, 1> == 3 && flat_index_v<nested, 2> == 4 && flat_index_v<deep, 0, 0, 1> == 1);
+static_assert(sizeof(flat_variant_t<variant<variant<int, float>, variant<unsigned, char>>>) <
+              sizeof(variant<variant<int, float>, variant<unsigned, char>>));
+
+constexpr bool flat_round_trip() {
+  deep d(in_place_index<0>, in_place_index<1>, short(5));
+  auto f = flatten(d);
+  deep back = unflatten<deep>(f);
+  return f.index() == 2 && get<2>(f) == 5 && back.index() == 0 && get<0>(back).index() == 1;
+}
+
+static_assert(flat_round_trip());
+} // namespace flat_layout
+
+TEST(flat_variant, flatten_and_unflatten) {
+  using namespace flat_layout;
+  nested n(in_place_index<1>, in_place_index<1>, std::vector<int>{1, 2});
+  auto f = flatten(n);
+  ASSERT_EQ(f.index(), 3);
+  ASSERT_EQ(get<3>(f), (std::vector<int>{1, 2}));
+  nested back = unflatten<nested>(std::move(f));
+  ASSERT_TRUE(back == n);
+
+  nested s(in_place_index<0>, std::string("abc"));
+  auto moved = flatten(std::move(s));
+  ASSERT_EQ(get<1>(moved), "abc");
+  ASSERT_TRUE(get<0>(s).index() == 1 && get<1>(get<0>(s)).empty());
+
+  auto c = flatten(nested('x'));
+  ASSERT_EQ(c.index(), (flat_index_v<nested, 2>));
+  ASSERT_EQ(unflatten<nested>(c), nested('x'));
+
+  nested valueless(in_place_index<2>, 'y');
+  ASSERT_THROW(valueless.emplace_with<0>([]() -> inner1 { throw std::exception(); }), std::exception);
+  ASSERT_THROW(static_cast<void>(flatten(valueless)), bad_variant_access);
+}
+
+TEST(flat_variant, visit_nested_with_group_handlers) {
+  using namespace flat_layout;
+  struct handler {
+    std::string operator()(variant_cref<int, std::string> g) const {
+      return "group1:" + std::to_string(g.index());
+    }
+    std::string operator()(double) const {
+      return "double";
+    }
+    std::string operator()(const std::vector<int>& v) const {
+      return "vector:" + std::to_string(v.size());
+    }
+    std::string operator()(char c) const {
+      return std::string("char:") + c;
+    }
+  };
+  const flat_variant_t<nested> a = flatten(nested(in_place_index<0>, std::string("s")));
+  ASSERT_EQ(visit_nested<nested>(handler{}, a), "group1:1");
+  ASSERT_EQ(visit_nested<nested>(handler{}, flatten(nested(inner1(3)))), "group1:0");
+  ASSERT_EQ(visit_nested<nested>(handler{}, flatten(nested(inner2(2.0)))), "double");
+  ASSERT_EQ(visit_nested<nested>(handler{}, flatten(nested('q'))), "char:q");
+
+  struct appender {
+    void operator()(variant_ref<int, std::string> g) const {
+      if (g.index() == 1) {
+        get<1>(g) += "c";
+      }
+    }
+    void operator()(double) const {}
+    void operator()(std::vector<int>&) const {}
+    void operator()(char) const {}
+  };
+  flat_variant_t<nested> m = flatten(nested(inner1(std::string("ab"))));
+  visit_nested<nested>(appender{}, m);
+  ASSERT_EQ(get<1>(m), "abc");
+}
+
+namespace cast_layout {
+using narrow = variant<int, std::string>;
+using wide = variant<double, std::string, int>;
+
+constexpr bool cast_in_constexpr() {
+  variant<int, char> a('c');
+  auto b = variant_cast<variant<char, long, int>>(a);
+  auto c = variant_cast<variant<int, char>>(b);
+  return b.index() == 0 && get<0>(b) == 'c' && c == a;
+}
+
+static_assert(cast_in_constexpr());
+
+template <typename Target, typename Source>
+concept has_cast = requires(Source& s) { variant_cast<Target>(s); };
+
+static_assert(has_cast<wide, narrow> && has_cast<narrow, wide> && has_cast<variant<int>, variant<int, int>>);
+static_assert(!has_cast<variant<int, int, double>, variant<int, double>>);
+static_assert(!has_cast<variant<char, float>, narrow>);
+} // namespace cast_layout
+
+TEST(variant_cast, widening_and_reordering) {
+  using namespace cast_layout;
+  narrow n(std::string(40, 'a'));
+  wide w = variant_cast<wide>(n);
+  ASSERT_EQ(w.index(), 1);
+  ASSERT_EQ(get<1>(w), std::string(40, 'a'));
+  ASSERT_EQ(get<1>(n), std::string(40, 'a'));
+
+  wide moved = variant_cast<wide>(std::move(n));
+  ASSERT_EQ(get<std::string>(moved), std::string(40, 'a'));
+  ASSERT_TRUE(get<1>(n).empty());
+
+  ASSERT_EQ(get<int>(variant_cast<wide>(narrow(7))), 7);
+  ASSERT_EQ((variant_cast<variant<std::string, int>>(narrow(7)).index()), 1);
+}
+
+TEST(variant_cast, narrowing_reports_failure) {
+  using namespace cast_layout;
+  wide w(2.5);
+  ASSERT_THROW(static_cast<void>(variant_cast<narrow>(w)), bad_variant_access);
+  auto failed = try_variant_cast<narrow>(w);
+  ASSERT_FALSE(failed.has_value());
+  ASSERT_EQ(failed.error(), 0);
+
+  w = 3;
+  auto ok = try_variant_cast<narrow>(w);
+  ASSERT_TRUE(ok.has_value());
+  ASSERT_EQ(get<int>(*ok), 3);
+  ASSERT_EQ(variant_cast<narrow>(w), narrow(3));
+
+  ASSERT_THROW(w.emplace_with<1>([]() -> std::string { throw std::exception(); }), std::exception);
+  ASSERT_THROW(static_cast<void>(variant_cast<narrow>(w)), bad_variant_access);
+  ASSERT_EQ(try_variant_cast<narrow>(w).error(), variant_npos);
+}
+
+TEST(variant_cast, spans) {
+  using namespace cast_layout;
+  std::vector<wide> from = {wide(1), wide(std::string(30, 'x')), wide(2.0), wide(4)};
+  std::vector<narrow> to(3);
+
+  ASSERT_EQ(variant_cast(std::span<const wide>(from), std::span<narrow>(to)), 2);
+  ASSERT_EQ(to[0], narrow(1));
+  ASSERT_EQ(to[1], narrow(std::string(30, 'x')));
+  ASSERT_EQ(get<1>(from[1]), std::string(30, 'x'));
+
+  std::vector<narrow> back = {narrow(5), narrow(std::string(30, 'y'))};
+  std::vector<wide> into(4);
+  ASSERT_EQ(variant_cast(std::span<narrow>(back), std::span<wide>(into)), 2);
+  ASSERT_EQ(get<int>(into[0]), 5);
+  ASSERT_EQ(get<std::string>(into[1]), std::string(30, 'y'));
+  ASSERT_TRUE(get<1>(back[1]).empty());
+  ASSERT_EQ(into[2].index(), 0);
+}
@@ -0,0 +1,24 @@
+// Module interface for the core of the library: `import variant;` gives the same names as including variant.h, but
+// the headers are parsed and their shared metaprogramming instantiated once, when this unit is built, instead of in
+// every translation unit. Build it with the variant-module target (VARIANT_BUILD_MODULE=ON).
+//
+// Configuration macros (VARIANT_NO_EXCEPTIONS, VARIANT_ACCESS_FAILURE_HANDLER) do not cross an import; they have to be
+// set when this unit is compiled. The declarations stay attached to the global module, so the extension headers
+// (vref.h, vexpected.h, ...) may be included next to the import on compilers that merge them.
+module;
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <type_traits>
+
+export module variant;
+
+#define VARIANT_BEGIN_EXPORT export extern "C++" {
+#define VARIANT_END_EXPORT }
+
+#include "variant.h"
@@ -3,7 +3,9 @@
 
 #include "vdefines.h"
 #include "vutils.h"
+#include <cstdint>
 
+VARIANT_BEGIN_EXPORT
 inline constexpr size_t variant_npos = -1;
 
 namespace details {
@@ -31,11 +33,16 @@ struct variadic_union_base<wrapper, trivially_destructible, Head, Tail...> {
   constexpr variadic_union_base(in_place_index_t<Index>, Args&&... args)
       : tail(in_place_index<Index - 1>, std::forward<Args>(args)...) {}
 
+  template <typename F>
+  constexpr variadic_union_base(in_place_factory_t<0>, F&& f) : head(std::invoke(std::forward<F>(f))) {}
+
+  template <typename F, size_t Index>
+  constexpr variadic_union_base(in_place_factory_t<Index>, F&& f)
+      : tail(in_place_factory<Index - 1>, std::forward<F>(f)) {}
+
   template <size_t Index>
   constexpr void reset(in_place_index_t<Index>) {}
 
-  constexpr ~variadic_union_base() = default;
-
   union {
     Head head;
     wrapper<Tail...> tail;
@@ -55,6 +62,13 @@ struct variadic_union_base<wrapper, false, Head, Tail...> {
   constexpr variadic_union_base(in_place_index_t<Index>, Args&&... args)
       : tail(in_place_index<Index - 1>, std::forward<Args>(args)...) {}
 
+  template <typename F>
+  constexpr variadic_union_base(in_place_factory_t<0>, F&& f) : head(std::invoke(std::forward<F>(f))) {}
+
+  template <typename F, size_t Index>
+  constexpr variadic_union_base(in_place_factory_t<Index>, F&& f)
+      : tail(in_place_factory<Index - 1>, std::forward<F>(f)) {}
+
   template <size_t Index>
   constexpr void reset(in_place_index_t<Index>) {
     if constexpr (Index > 0) {
@@ -93,6 +107,9 @@ struct variadic_union<Head, Types...>
   template <typename... Args, size_t Index>
   constexpr variadic_union(in_place_index_t<Index> in, Args&&... args) : base(in, std::forward<Args>(args)...) {}
 
+  template <typename F, size_t Index>
+  constexpr variadic_union(in_place_factory_t<Index> in, F&& f) : base(in, std::forward<F>(f)) {}
+
   template <typename... Args, size_t Index>
   constexpr auto& set(in_place_index_t<Index>, Args&&... args) {
     if constexpr (Index > 0) {
@@ -120,45 +137,60 @@ struct variadic_union<Head, Types...>
       return head;
     }
   }
-
-  constexpr ~variadic_union() = default;
 };
 
+// The smallest unsigned type that holds every index plus a valueless marker, so that small variants stay small.
+template <size_t N>
+using variant_index_t =
+    std::conditional_t<(N < UINT8_MAX), uint8_t, std::conditional_t<(N < UINT16_MAX), uint16_t, size_t>>;
+
 template <bool trivially_destructible, typename... Types>
 struct vstorage_base {
+  using index_type = variant_index_t<sizeof...(Types)>;
+
+  static constexpr index_type npos = index_type(-1);
+
   constexpr vstorage_base() : index_(0) {}
 
-  constexpr vstorage_base(undefined_t u) noexcept : index_(variant_npos), storage(u) {}
+  constexpr vstorage_base(undefined_t u) noexcept : index_(npos), storage(u) {}
 
   template <typename... Args, size_t Index>
   constexpr vstorage_base(in_place_index_t<Index> in, Args&&... args)
       : index_(Index), storage(in, std::forward<Args>(args)...) {}
 
+  template <typename F, size_t Index>
+  constexpr vstorage_base(in_place_factory_t<Index> in, F&& f) : index_(Index), storage(in, std::forward<F>(f)) {}
+
   constexpr void reset() {}
 
   //        constexpr size_t index() {
   //            return index_;
   //        }
 
-  constexpr ~vstorage_base() = default;
-
 protected:
-  size_t index_ = variant_npos;
+  index_type index_ = npos;
   variadic_union<Types...> storage;
 };
 
 template <typename... Types>
 struct vstorage_base<false, Types...> {
+  using index_type = variant_index_t<sizeof...(Types)>;
+
+  static constexpr index_type npos = index_type(-1);
+
   constexpr vstorage_base() : index_(0) {}
 
-  constexpr vstorage_base(undefined_t u) noexcept : index_(variant_npos), storage(u) {}
+  constexpr vstorage_base(undefined_t u) noexcept : index_(npos), storage(u) {}
 
   template <typename... Args, size_t Index>
   constexpr vstorage_base(in_place_index_t<Index>, Args&&... args)
       : index_(Index), storage(in_place_index<Index>, std::forward<Args>(args)...) {}
 
+  template <typename F, size_t Index>
+  constexpr vstorage_base(in_place_factory_t<Index> in, F&& f) : index_(Index), storage(in, std::forward<F>(f)) {}
+
   constexpr void reset() {
-    if (index_ == variant_npos) {
+    if (index_ == npos) {
       return;
     }
     visit_by_index([this](auto index) { (*this).storage.reset(in_place_index<index>); },
@@ -170,7 +202,7 @@ struct vstorage_base<false, Types...> {
   }
 
 protected:
-  size_t index_ = variant_npos;
+  index_type index_ = npos;
   variadic_union<Types...> storage;
 };
 
@@ -178,6 +210,7 @@ template <typename... Types>
 struct vstorage : vstorage_base<is_trivially_destructible<Types...>, Types...> {
   using base = vstorage_base<is_trivially_destructible<Types...>, Types...>;
   using base::index_;
+  using base::npos;
   using base::reset;
   using base::storage;
 
@@ -188,15 +221,37 @@ struct vstorage : vstorage_base<is_trivially_destructible<Types...>, Types...> {
   template <typename... Args, size_t Index>
   constexpr vstorage(in_place_index_t<Index> in, Args&&... args) : base(in, std::forward<Args>(args)...) {}
 
+  template <typename F, size_t Index>
+  constexpr vstorage(in_place_factory_t<Index> in, F&& f) : base(in, std::forward<F>(f)) {}
+
   template <typename... Args, size_t Index>
   constexpr decltype(auto) set(in_place_index_t<Index>, Args&&... args) {
     auto& result = storage.set(in_place_index<Index>, std::forward<Args>(args)...);
-    index_ = Index;
+    index_ = static_cast<typename base::index_type>(Index);
     return result;
   }
 
+  // Recreates the (valueless) union with alternative Index initialized from f's prvalue in a member initializer, which
+  // elides the result into place in constant evaluation too, where placement new is not available.
+  template <typename F, size_t Index>
+  constexpr decltype(auto) set_with(in_place_factory_t<Index> in, F&& f) {
+    std::construct_at(std::addressof(storage), in, std::forward<F>(f));
+    index_ = static_cast<typename base::index_type>(Index);
+    return storage.get(in_place_index<Index>);
+  }
+
+  // npos wraps to 0 and back to variant_npos, which avoids a branch.
   constexpr size_t index() const {
-    return index_;
+    return size_t(typename base::index_type(index_ + 1)) - 1;
+  }
+
+  // Where the storage of a variant starts; the active alternative, whichever it is, lives at this address.
+  static constexpr void* data(variant<Types...>& v) noexcept {
+    return std::addressof(static_cast<vstorage&>(v).storage);
+  }
+
+  static constexpr const void* data(const variant<Types...>& v) noexcept {
+    return std::addressof(static_cast<const vstorage&>(v).storage);
   }
 };
 
@@ -232,7 +287,7 @@ struct variant : private details::vstorage_t<Types...> {
   constexpr variant() noexcept(std::is_nothrow_default_constructible_v<default_t>) = delete;
 
   template <typename From, typename To_Info = details::chosen_construct_type<From, Types...>>
-  constexpr variant(From&& f) noexcept(std::is_nothrow_constructible_v<From, typename To_Info::type>)
+  constexpr variant(From&& f) noexcept(std::is_nothrow_constructible_v<typename To_Info::type, From>)
       requires details::is_convertible_to<From, typename To_Info::type, variant, Types...>
       : parent_t(in_place_index<To_Info::index>, std::forward<From>(f)) {}
 
@@ -345,6 +400,12 @@ struct variant : private details::vstorage_t<Types...> {
       requires(std::is_constructible_v<Type_by_Index, Args...> && !std::is_same_v<Type_by_Index, void>)
       : parent_t(in_place_index<Index>, std::forward<Args>(args)...) {}
 
+  // Builds alternative Index from the result of factory() directly in the variant's storage, without moving it.
+  template <size_t Index, typename F, typename Type_by_Index = details::get_type_t<Index, Types...>>
+  constexpr explicit variant(in_place_factory_t<Index>, F&& factory)
+      requires(details::is_factory_for<F, Type_by_Index>)
+      : parent_t(in_place_factory<Index>, std::forward<F>(factory)) {}
+
   template <size_t Index, typename Type_by_Index = details::get_type_t<Index, Types...>, typename... Args>
   constexpr Type_by_Index& emplace(Args&&... args) requires(std::is_constructible_v<Type_by_Index, Args...>) {
     static_assert(Index < sizeof...(Types));
@@ -359,6 +420,22 @@ struct variant : private details::vstorage_t<Types...> {
     return emplace<Index, T>(std::forward<Args>(args)...);
   }
 
+  // Like emplace, with the new alternative initialized from the result of factory() in place, so it may be a type that
+  // cannot be moved. The current value is destroyed before factory runs; if factory throws, the variant is valueless.
+  template <size_t Index, typename F, typename Type_by_Index = details::get_type_t<Index, Types...>>
+  constexpr Type_by_Index& emplace_with(F&& factory) requires(details::is_factory_for<F, Type_by_Index>) {
+    static_assert(Index < sizeof...(Types));
+
+    make_valueless();
+    return parent_t::set_with(in_place_factory<Index>, std::forward<F>(factory));
+  }
+
+  template <typename T, typename F, size_t Index = details::find_first_v<T, Types...>>
+  constexpr T& emplace_with(F&& factory)
+      requires((details::count_of_v<T, Types...> == 1) && details::is_factory_for<F, T>) {
+    return emplace_with<Index>(std::forward<F>(factory));
+  }
+
   constexpr void swap(variant& other) noexcept(
       details::is_nothrow_move_constructible<Types...>&& details::is_nothrow_swappable<Types...>) {
     if (valueless_by_exception() && other.valueless_by_exception()) {
@@ -399,9 +476,9 @@ struct variant : private details::vstorage_t<Types...> {
   }
 
   constexpr void make_valueless() noexcept {
-    if (this->index_ != variant_npos) {
+    if (this->index_ != parent_t::npos) {
       this->reset();
-      this->index_ = variant_npos;
+      this->index_ = parent_t::npos;
     }
   }
 
@@ -492,4 +569,92 @@ constexpr bool operator>=(variant<Types...> const& a, variant<Types...> const& b
   return details::visit_by_index([&](auto index) { return get<index>(a) >= get<index>(b); }, b);
 }
 
+template <typename... Types, typename T>
+constexpr bool operator==(variant<Types...> const& a, T const& b) noexcept
+    requires(details::compares_as_alternative<T, Types...>) {
+  constexpr size_t index = details::compared_index_v<T, Types...>;
+  return a.index() == index && get<index>(a) == b;
+}
+
+template <typename... Types, typename T>
+constexpr bool operator<(variant<Types...> const& a, T const& b) noexcept
+    requires(details::compares_as_alternative<T, Types...>) {
+  constexpr size_t index = details::compared_index_v<T, Types...>;
+  if (a.index() != index) {
+    return a.valueless_by_exception() || a.index() < index;
+  }
+  return get<index>(a) < b;
+}
+
+template <typename... Types, typename T>
+constexpr bool operator<(T const& a, variant<Types...> const& b) noexcept
+    requires(details::compares_as_alternative<T, Types...>) {
+  constexpr size_t index = details::compared_index_v<T, Types...>;
+  if (b.index() != index) {
+    return !b.valueless_by_exception() && index < b.index();
+  }
+  return a < get<index>(b);
+}
+
+template <typename... Types, typename T>
+constexpr bool operator>(variant<Types...> const& a, T const& b) noexcept
+    requires(details::compares_as_alternative<T, Types...>) {
+  constexpr size_t index = details::compared_index_v<T, Types...>;
+  if (a.index() != index) {
+    return !a.valueless_by_exception() && a.index() > index;
+  }
+  return get<index>(a) > b;
+}
+
+template <typename... Types, typename T>
+constexpr bool operator>(T const& a, variant<Types...> const& b) noexcept
+    requires(details::compares_as_alternative<T, Types...>) {
+  constexpr size_t index = details::compared_index_v<T, Types...>;
+  if (b.index() != index) {
+    return b.valueless_by_exception() || index > b.index();
+  }
+  return a > get<index>(b);
+}
+
+template <typename... Types, typename T>
+constexpr bool operator<=(variant<Types...> const& a, T const& b) noexcept
+    requires(details::compares_as_alternative<T, Types...>) {
+  constexpr size_t index = details::compared_index_v<T, Types...>;
+  if (a.index() != index) {
+    return a.valueless_by_exception() || a.index() < index;
+  }
+  return get<index>(a) <= b;
+}
+
+template <typename... Types, typename T>
+constexpr bool operator<=(T const& a, variant<Types...> const& b) noexcept
+    requires(details::compares_as_alternative<T, Types...>) {
+  constexpr size_t index = details::compared_index_v<T, Types...>;
+  if (b.index() != index) {
+    return !b.valueless_by_exception() && index < b.index();
+  }
+  return a <= get<index>(b);
+}
+
+template <typename... Types, typename T>
+constexpr bool operator>=(variant<Types...> const& a, T const& b) noexcept
+    requires(details::compares_as_alternative<T, Types...>) {
+  constexpr size_t index = details::compared_index_v<T, Types...>;
+  if (a.index() != index) {
+    return !a.valueless_by_exception() && a.index() > index;
+  }
+  return get<index>(a) >= b;
+}
+
+template <typename... Types, typename T>
+constexpr bool operator>=(T const& a, variant<Types...> const& b) noexcept
+    requires(details::compares_as_alternative<T, Types...>) {
+  constexpr size_t index = details::compared_index_v<T, Types...>;
+  if (b.index() != index) {
+    return b.valueless_by_exception() || index > b.index();
+  }
+  return a >= get<index>(b);
+}
+VARIANT_END_EXPORT
+
 #endif
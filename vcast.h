@@ -0,0 +1,120 @@
+#ifndef VARIANT_CAST_H
+#define VARIANT_CAST_H
+
+#include "variant.h"
+#include "vexpected.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+// Conversions between variants whose alternatives overlap: widening to a superset, reordering, and narrowing to a
+// subset, which fails for values of the alternatives the target lacks. Every source alternative is matched by type
+// with the target alternative of the same type at compile time, and the value is moved (or copied, from an lvalue)
+// straight into that alternative of the result. A target that holds a source type more than once, or shares no type
+// with the source, is rejected at compile time.
+
+namespace details {
+template <typename Source, typename Target>
+struct cast_map;
+
+template <typename... From, typename... To>
+struct cast_map<variant<From...>, variant<To...>> {
+  // The target index of each source alternative, or variant_npos where the target has no alternative of that type.
+  static constexpr std::array<size_t, sizeof...(From)> indexes = {
+      (count_of_v<From, To...> == 1 ? find_first_v<From, To...> : variant_npos)...};
+};
+
+template <typename Source, typename Target>
+struct cast_check : std::false_type {};
+
+// Every source alternative has at most one target alternative of its type, so the cast is never ambiguous, and at
+// least one has any, so it is not bound to fail.
+template <typename... From, typename... To>
+struct cast_check<variant<From...>, variant<To...>>
+    : std::bool_constant<((count_of_v<From, To...> <= 1) && ...) && ((count_of_v<From, To...> == 1) || ...)> {};
+
+template <typename Source, typename Target>
+concept is_castable = is_variant_v<Source> && is_variant_v<Target> && cast_check<Source, Target>::value;
+
+// Builds the result, Target or an expected of it, from the source's alternative, or calls on_missing with the index
+// of a source alternative the target lacks.
+template <typename Target, typename Source, typename F>
+constexpr std::invoke_result_t<F, size_t> cast_by_index(Source&& source, F on_missing) {
+  using map = cast_map<std::remove_cvref_t<Source>, Target>;
+  using result_t = std::invoke_result_t<F, size_t>;
+  return visit_by_index(
+      [&](auto index) -> result_t {
+        constexpr size_t to = map::indexes[index];
+        if constexpr (to == variant_npos) {
+          return on_missing(size_t(index));
+        } else if constexpr (std::is_same_v<result_t, Target>) {
+          return Target(in_place_index<to>, get<index>(std::forward<Source>(source)));
+        } else {
+          return result_t(in_place, in_place_index<to>, get<index>(std::forward<Source>(source)));
+        }
+      },
+      source);
+}
+} // namespace details
+
+// Converts to Target. A widening or reordering cast cannot fail; a narrowing one fails with bad_variant_access ("bad
+// variant cast") when source holds an alternative Target lacks. A valueless source fails in either case.
+template <typename Target, typename Source>
+constexpr Target variant_cast(Source&& source) requires(details::is_castable<std::remove_cvref_t<Source>, Target>) {
+  if (source.valueless_by_exception()) {
+    details::throw_bad_variant_access();
+  }
+  return details::cast_by_index<Target>(std::forward<Source>(source), [](size_t) -> Target {
+    details::throw_bad_variant_access("bad variant cast");
+  });
+}
+
+// Like variant_cast, but reports a failure as the index of the source alternative Target lacks (variant_npos for a
+// valueless source) instead of throwing.
+template <typename Target, typename Source>
+constexpr expected<Target, size_t> try_variant_cast(Source&& source) requires(
+    details::is_castable<std::remove_cvref_t<Source>, Target>) {
+  if (source.valueless_by_exception()) {
+    return unexpected(variant_npos);
+  }
+  return details::cast_by_index<Target>(std::forward<Source>(source), [](size_t index) -> expected<Target, size_t> {
+    return unexpected(index);
+  });
+}
+
+// Converts from[i] into to[i], moving out of from unless its elements are const; pass std::span<const Source> to copy.
+// Stops at the end of the shorter span, or at the first element that cannot be converted, and returns the number of
+// elements converted.
+template <typename Target, typename Source, size_t FromExtent, size_t ToExtent>
+size_t variant_cast(std::span<Source, FromExtent> from, std::span<Target, ToExtent> to) requires(
+    details::is_castable<std::remove_const_t<Source>, Target>) {
+  using map = details::cast_map<std::remove_const_t<Source>, Target>;
+  using qualified_t = std::conditional_t<std::is_const_v<Source>, Source&, Source&&>;
+  size_t count = std::min(from.size(), to.size());
+  for (size_t i = 0; i < count; ++i) {
+    auto& source = from[i];
+    if (source.valueless_by_exception()) {
+      return i;
+    }
+    bool converted = details::visit_by_index(
+        [&](auto index) {
+          constexpr size_t target = map::indexes[index];
+          if constexpr (target == variant_npos) {
+            return false;
+          } else {
+            to[i].template emplace<target>(get<index>(static_cast<qualified_t>(source)));
+            return true;
+          }
+        },
+        source);
+    if (!converted) {
+      return i;
+    }
+  }
+  return count;
+}
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef VARIANT_CODEC_H
+#define VARIANT_CODEC_H
+
+#include <concepts>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+template <typename T>
+struct variant_codec;
+
+template <>
+struct variant_codec<std::string> {
+  static void encode(const std::string& value, std::string& out) {
+    out.append(value);
+  }
+
+  static std::string decode(std::string_view bytes) {
+    return std::string(bytes);
+  }
+};
+
+namespace details {
+template <typename T>
+concept codec_raw = std::is_trivially_copyable_v<T>;
+
+template <typename T>
+concept codec_encodable = requires(const T& value, std::string& out, std::string_view bytes) {
+  variant_codec<T>::encode(value, out);
+  { variant_codec<T>::decode(bytes) } -> std::same_as<T>;
+};
+
+template <typename T>
+concept codec_storable = codec_raw<T> || codec_encodable<T>;
+} // namespace details
+
+#endif
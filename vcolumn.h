@@ -0,0 +1,440 @@
+#ifndef VARIANT_COLUMN_H
+#define VARIANT_COLUMN_H
+
+#include "variant.h"
+#include "vcodec.h"
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// On-disk layout (native endianness):
+//   column_header | column_section[N] | tags[rows] | slots[rows] | section 0 | ... | section N-1
+// tags hold the alternative index of every row, slots hold the position of the row inside its alternative section.
+// Trivially copyable alternatives are stored as a raw array, the rest as (count + 1) offsets followed by a blob
+// produced by variant_codec<T>. Every region starts at a column_alignment boundary.
+
+class column_error : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+namespace details {
+inline constexpr char column_magic[8] = {'V', 'C', 'O', 'L', 'U', 'M', 'N', '\0'};
+inline constexpr uint32_t column_version = 1;
+inline constexpr size_t column_alignment = 64;
+
+struct column_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t alternatives;
+  uint64_t rows;
+  uint32_t tag_width;
+  uint32_t slot_width;
+  uint64_t tags_offset;
+  uint64_t slots_offset;
+};
+
+struct column_section {
+  uint64_t offset;
+  uint64_t count;
+  uint64_t bytes;
+  uint32_t encoded;
+  uint32_t element_size;
+};
+
+constexpr uint64_t column_align(uint64_t offset) noexcept {
+  return (offset + column_alignment - 1) / column_alignment * column_alignment;
+}
+
+constexpr uint32_t column_tag_width(size_t alternatives) noexcept {
+  return alternatives <= UINT8_MAX ? 1 : (alternatives <= UINT16_MAX ? 2 : 4);
+}
+
+inline uint64_t column_load(const std::byte* data, uint32_t width) noexcept {
+  switch (width) {
+  case 1:
+    return std::to_integer<uint64_t>(*data);
+  case 2: {
+    uint16_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+  }
+  case 4: {
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+  }
+  default: {
+    uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+  }
+  }
+}
+
+template <typename T>
+struct column_section_builder {
+  void push(const T& value) {
+    if constexpr (codec_raw<T>) {
+      data.append(reinterpret_cast<const char*>(std::addressof(value)), sizeof(T));
+    } else {
+      variant_codec<T>::encode(value, data);
+      offsets.push_back(data.size());
+    }
+    ++count;
+  }
+
+  column_section describe(uint64_t offset) const noexcept {
+    if constexpr (codec_raw<T>) {
+      return {offset, count, data.size(), 0, sizeof(T)};
+    } else {
+      return {offset, count, data.size(), 1, 0};
+    }
+  }
+
+  uint64_t size() const noexcept {
+    return data.size() + (codec_raw<T> ? 0 : offsets.size() * sizeof(uint64_t));
+  }
+
+  std::string data;
+  std::vector<uint64_t> offsets{0};
+  uint64_t count = 0;
+};
+
+class mapped_file {
+public:
+  mapped_file() = default;
+
+  explicit mapped_file(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      throw column_error("cannot open column file " + path);
+    }
+    struct stat st {};
+    if (::fstat(fd, &st) != 0) {
+      ::close(fd);
+      throw column_error("cannot stat column file " + path);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ != 0) {
+      void* data = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+      if (data == MAP_FAILED) {
+        ::close(fd);
+        throw column_error("cannot map column file " + path);
+      }
+      data_ = static_cast<const std::byte*>(data);
+    }
+    ::close(fd);
+  }
+
+  mapped_file(mapped_file&& other) noexcept
+      : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)) {}
+
+  mapped_file& operator=(mapped_file&& other) noexcept {
+    if (this != &other) {
+      unmap();
+      data_ = std::exchange(other.data_, nullptr);
+      size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+  }
+
+  ~mapped_file() {
+    unmap();
+  }
+
+  const std::byte* data() const noexcept {
+    return data_;
+  }
+
+  size_t size() const noexcept {
+    return size_;
+  }
+
+private:
+  void unmap() noexcept {
+    if (data_ != nullptr) {
+      ::munmap(const_cast<std::byte*>(data_), size_);
+    }
+  }
+
+  const std::byte* data_ = nullptr;
+  size_t size_ = 0;
+};
+} // namespace details
+
+template <typename... Types>
+struct column_writer {
+  static_assert((details::codec_storable<Types> && ...),
+                "every alternative must be trivially copyable or have a variant_codec specialization");
+
+  void push_back(const variant<Types...>& v) {
+    if (v.valueless_by_exception()) {
+      details::throw_bad_variant_access("valueless variant can not be stored in a column");
+    }
+    details::visit_by_index([&v, this](auto index) { push_back(in_place_index<index>, get<index>(v)); }, v);
+  }
+
+  template <size_t Index>
+  void push_back(in_place_index_t<Index>, const details::get_type_t<Index, Types...>& value) {
+    auto& section = std::get<Index>(sections_);
+    tags_.push_back(Index);
+    slots_.push_back(section.count);
+    section.push(value);
+  }
+
+  size_t size() const noexcept {
+    return tags_.size();
+  }
+
+  void write(std::ostream& out) const {
+    constexpr size_t alternatives = sizeof...(Types);
+    details::column_header header{};
+    std::memcpy(header.magic, details::column_magic, sizeof(header.magic));
+    header.version = details::column_version;
+    header.alternatives = alternatives;
+    header.rows = tags_.size();
+    header.tag_width = details::column_tag_width(alternatives);
+    header.slot_width = (tags_.size() <= UINT32_MAX) ? 4 : 8;
+    header.tags_offset =
+        details::column_align(sizeof(details::column_header) + alternatives * sizeof(details::column_section));
+    header.slots_offset = details::column_align(header.tags_offset + header.rows * header.tag_width);
+
+    std::array<details::column_section, alternatives> table{};
+    uint64_t offset = details::column_align(header.slots_offset + header.rows * header.slot_width);
+    [&]<size_t... Is>(std::index_sequence<Is...>) {
+      ((table[Is] = std::get<Is>(sections_).describe(offset),
+        offset = details::column_align(offset + std::get<Is>(sections_).size())),
+       ...);
+    }(std::make_index_sequence<alternatives>());
+
+    uint64_t written = 0;
+    auto put = [&out, &written](const void* data, size_t size) {
+      out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+      written += size;
+    };
+    auto put_int = [&put](uint64_t value, uint32_t width) {
+      if (width == 1) {
+        auto narrow = static_cast<uint8_t>(value);
+        put(&narrow, width);
+      } else if (width == 2) {
+        auto narrow = static_cast<uint16_t>(value);
+        put(&narrow, width);
+      } else if (width == 4) {
+        auto narrow = static_cast<uint32_t>(value);
+        put(&narrow, width);
+      } else {
+        put(&value, width);
+      }
+    };
+    auto pad = [&out, &written](uint64_t target) {
+      for (; written < target; ++written) {
+        out.put('\0');
+      }
+    };
+
+    put(&header, sizeof(header));
+    put(table.data(), sizeof(details::column_section) * alternatives);
+    pad(header.tags_offset);
+    for (uint32_t tag : tags_) {
+      put_int(tag, header.tag_width);
+    }
+    pad(header.slots_offset);
+    for (uint64_t slot : slots_) {
+      put_int(slot, header.slot_width);
+    }
+    [&]<size_t... Is>(std::index_sequence<Is...>) {
+      auto write_section = [&](const auto& section, const details::column_section& desc) {
+        pad(desc.offset);
+        if (desc.encoded != 0) {
+          put(section.offsets.data(), section.offsets.size() * sizeof(uint64_t));
+        }
+        put(section.data.data(), section.data.size());
+      };
+      (write_section(std::get<Is>(sections_), table[Is]), ...);
+    }(std::make_index_sequence<alternatives>());
+    if (!out) {
+      throw column_error("failed to write column");
+    }
+  }
+
+  void write(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      throw column_error("cannot create column file " + path);
+    }
+    write(out);
+  }
+
+private:
+  std::vector<uint32_t> tags_;
+  std::vector<uint64_t> slots_;
+  std::tuple<details::column_section_builder<Types>...> sections_;
+};
+
+template <typename... Types>
+struct mapped_column {
+  static_assert((details::codec_storable<Types> && ...),
+                "every alternative must be trivially copyable or have a variant_codec specialization");
+
+  explicit mapped_column(const std::string& path) : file_(path) {
+    constexpr size_t alternatives = sizeof...(Types);
+    if (file_.size() < sizeof(details::column_header) + alternatives * sizeof(details::column_section)) {
+      throw column_error("column file is truncated");
+    }
+    std::memcpy(&header_, file_.data(), sizeof(header_));
+    if (std::memcmp(header_.magic, details::column_magic, sizeof(header_.magic)) != 0 ||
+        header_.version != details::column_version) {
+      throw column_error("not a variant column file");
+    }
+    if (header_.alternatives != alternatives || header_.tag_width != details::column_tag_width(alternatives) ||
+        (header_.slot_width != 4 && header_.slot_width != 8)) {
+      throw column_error("column file does not match the variant type");
+    }
+    if (!fits(header_.tags_offset, header_.rows, header_.tag_width) ||
+        !fits(header_.slots_offset, header_.rows, header_.slot_width)) {
+      throw column_error("column file is truncated");
+    }
+    std::memcpy(sections_.data(), file_.data() + sizeof(details::column_header),
+                alternatives * sizeof(details::column_section));
+    [this]<size_t... Is>(std::index_sequence<Is...>) {
+      (check_section<Is>(), ...);
+    }(std::make_index_sequence<alternatives>());
+    // index() and slot() are trusted by visit_index and value(), so every row is checked once here
+    for (size_t row = 0; row < header_.rows; ++row) {
+      size_t tag = index(row);
+      if (tag >= alternatives || slot(row) >= sections_[tag].count) {
+        throw column_error("corrupted column row table");
+      }
+    }
+  }
+
+  size_t size() const noexcept {
+    return header_.rows;
+  }
+
+  size_t index(size_t row) const noexcept {
+    return details::column_load(file_.data() + header_.tags_offset + row * header_.tag_width, header_.tag_width);
+  }
+
+  template <size_t Index>
+  size_t count() const noexcept {
+    return sections_[Index].count;
+  }
+
+  template <size_t Index, typename T = details::get_type_t<Index, Types...>>
+  T get(size_t row) const {
+    if (index(row) != Index) {
+      details::throw_bad_variant_access();
+    }
+    return value<Index>(slot(row));
+  }
+
+  template <size_t Index, typename T = details::get_type_t<Index, Types...>>
+  T value(size_t ordinal) const {
+    const details::column_section& section = sections_[Index];
+    if (ordinal >= section.count) {
+      throw column_error("column section ordinal out of range");
+    }
+    const std::byte* base = file_.data() + section.offset;
+    if constexpr (details::codec_raw<T>) {
+      std::array<std::byte, sizeof(T)> bytes;
+      std::memcpy(bytes.data(), base + ordinal * sizeof(T), sizeof(T));
+      return std::bit_cast<T>(bytes);
+    } else {
+      uint64_t bounds[2];
+      std::memcpy(bounds, base + ordinal * sizeof(uint64_t), sizeof(bounds));
+      if (bounds[0] > bounds[1] || bounds[1] > section.bytes) {
+        throw column_error("corrupted encoded column section");
+      }
+      const char* blob = reinterpret_cast<const char*>(base + (section.count + 1) * sizeof(uint64_t));
+      return variant_codec<T>::decode(std::string_view(blob + bounds[0], bounds[1] - bounds[0]));
+    }
+  }
+
+  template <size_t Index>
+  std::span<const std::byte> raw_section() const noexcept
+      requires details::codec_raw<details::get_type_t<Index, Types...>> {
+    return {file_.data() + sections_[Index].offset, sections_[Index].bytes};
+  }
+
+  variant<Types...> operator[](size_t row) const {
+    size_t ordinal = slot(row);
+    return details::visit_index<sizeof...(Types)>(
+        [ordinal, this](auto index) { return variant<Types...>(in_place_index<index>, value<index>(ordinal)); },
+        index(row));
+  }
+
+  template <typename F>
+  decltype(auto) visit(size_t row, F&& f) const {
+    size_t ordinal = slot(row);
+    return details::visit_index<sizeof...(Types)>(
+        [&f, ordinal, this](auto index) -> decltype(auto) {
+          return std::invoke(std::forward<F>(f), value<index>(ordinal));
+        },
+        index(row));
+  }
+
+  template <size_t Index, typename F>
+  void scan(F&& f) const {
+    size_t n = count<Index>();
+    for (size_t i = 0; i < n; ++i) {
+      std::invoke(f, value<Index>(i));
+    }
+  }
+
+private:
+  bool fits(uint64_t offset, uint64_t bytes) const noexcept {
+    return offset <= file_.size() && bytes <= file_.size() - offset;
+  }
+
+  // count elements of width bytes each, without computing count * width
+  bool fits(uint64_t offset, uint64_t count, uint64_t width) const noexcept {
+    return offset <= file_.size() && count <= (file_.size() - offset) / width;
+  }
+
+  size_t slot(size_t row) const noexcept {
+    return details::column_load(file_.data() + header_.slots_offset + row * header_.slot_width, header_.slot_width);
+  }
+
+  template <size_t Index>
+  void check_section() const {
+    using T = details::get_type_t<Index, Types...>;
+    const details::column_section& section = sections_[Index];
+    if constexpr (details::codec_raw<T>) {
+      if (section.encoded != 0 || section.element_size != sizeof(T) || !fits(section.offset, section.count, sizeof(T)) ||
+          section.bytes != section.count * sizeof(T)) {
+        throw column_error("corrupted raw column section");
+      }
+    } else {
+      if (section.encoded != 1 || section.count == UINT64_MAX ||
+          !fits(section.offset, section.count + 1, sizeof(uint64_t))) {
+        throw column_error("corrupted encoded column section");
+      }
+      if (!fits(section.offset + (section.count + 1) * sizeof(uint64_t), section.bytes)) {
+        throw column_error("corrupted encoded column section");
+      }
+    }
+  }
+
+  details::mapped_file file_;
+  details::column_header header_{};
+  std::array<details::column_section, sizeof...(Types)> sections_{};
+};
+
+#endif
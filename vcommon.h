@@ -0,0 +1,118 @@
+#ifndef VARIANT_COMMON_H
+#define VARIANT_COMMON_H
+
+#include "variant.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+
+// Access to a subobject that every alternative has, such as a common base or a header member, without a visit. The
+// offset of the subobject from the start of the variant's storage is looked up by index in a table kept per variant
+// type and projection; an entry is learned by a visit the first time its alternative is seen, after which an access is
+// a single indexed load. Bases that are virtual in some alternative have no fixed offset and are always visited.
+
+namespace details {
+template <typename Base, typename T>
+concept is_fixed_base_of = std::is_same_v<Base, T> || requires(Base* b) { static_cast<T*>(b); };
+
+// The offset table is keyed by the projection's type, so only stateless projections are accepted: two objects of a
+// stateful type, e.g. std::mem_fn(&T::a) and std::mem_fn(&T::b), could select different members.
+template <typename F, typename... Types>
+concept is_common_projection =
+    std::is_empty_v<std::remove_cvref_t<F>> && std::is_lvalue_reference_v<std::invoke_result_t<F, get_type_t<0, Types...>>> &&
+    (std::is_same_v<std::invoke_result_t<F, Types>, std::invoke_result_t<F, get_type_t<0, Types...>>> && ...);
+
+template <typename Base>
+struct to_base {
+  template <typename T>
+  constexpr auto& operator()(T& value) const noexcept {
+    return static_cast<std::conditional_t<std::is_const_v<T>, const Base&, Base&>>(value);
+  }
+};
+
+// Offsets plus one, so that the zero-initialized table stands for nothing learned yet. Threads that learn an entry
+// at the same time store the same value, and relaxed loads compile to plain ones.
+template <typename Projection, typename Variant>
+inline std::array<std::atomic<ptrdiff_t>, variant_size_v<Variant>> common_offsets{};
+
+template <typename... Types>
+void* storage_data(variant<Types...>& v) noexcept {
+  return vstorage<Types...>::data(v);
+}
+
+template <typename... Types>
+const void* storage_data(const variant<Types...>& v) noexcept {
+  return vstorage<Types...>::data(v);
+}
+
+template <typename Projection, typename Variant, typename F>
+auto& project_common(Variant& v, F& f) {
+  using result_t = std::remove_reference_t<decltype(std::invoke(f, get<0>(v)))>;
+  using byte_t = std::conditional_t<std::is_const_v<Variant>, const std::byte, std::byte>;
+
+  if (v.valueless_by_exception()) {
+    throw_bad_variant_access();
+  }
+  auto* data = static_cast<byte_t*>(storage_data(v));
+  auto& entry = common_offsets<Projection, std::remove_const_t<Variant>>[v.index()];
+  ptrdiff_t offset = entry.load(std::memory_order_relaxed);
+  if (offset == 0) [[unlikely]] {
+    offset = 1 + visit_by_index(
+                     [&](auto index) {
+                       return reinterpret_cast<byte_t*>(std::addressof(std::invoke(f, get<index>(v)))) - data;
+                     },
+                     v);
+    entry.store(offset, std::memory_order_relaxed);
+  }
+  return *std::launder(reinterpret_cast<result_t*>(data + (offset - 1)));
+}
+} // namespace details
+
+template <typename Base, typename... Types>
+constexpr Base& as_common(variant<Types...>& v) requires(std::is_convertible_v<Types*, Base*>&&...) {
+  if constexpr ((details::is_fixed_base_of<Base, Types> && ...)) {
+    if (!std::is_constant_evaluated()) {
+      details::to_base<Base> f;
+      return details::project_common<details::to_base<Base>>(v, f);
+    }
+  }
+  return *visit([](auto& value) { return static_cast<Base*>(std::addressof(value)); }, v);
+}
+
+template <typename Base, typename... Types>
+constexpr const Base& as_common(const variant<Types...>& v) requires(std::is_convertible_v<Types*, Base*>&&...) {
+  if constexpr ((details::is_fixed_base_of<Base, Types> && ...)) {
+    if (!std::is_constant_evaluated()) {
+      details::to_base<Base> f;
+      return details::project_common<details::to_base<Base>>(v, f);
+    }
+  }
+  return *visit([](const auto& value) { return static_cast<const Base*>(std::addressof(value)); }, v);
+}
+
+// Projects every alternative to the same subobject type, e.g. `common_member(v, [](auto& p) -> auto& { return
+// p.header; })`. f must return a reference into the alternative at a position fixed by its type: a data member, or a
+// member of a non-virtual base, but nothing reached through a pointer. f must be stateless (a captureless lambda or an
+// empty function object), and is called only while an entry is learned.
+template <typename F, typename... Types, typename R = std::invoke_result_t<F, details::get_type_t<0, Types...>&>>
+constexpr R common_member(variant<Types...>& v, F&& f) requires(details::is_common_projection<F, Types&...>) {
+  if (std::is_constant_evaluated()) {
+    return *visit([&f](auto& value) { return std::addressof(std::invoke(f, value)); }, v);
+  }
+  return details::project_common<std::remove_cvref_t<F>>(v, f);
+}
+
+template <typename F, typename... Types,
+          typename R = std::invoke_result_t<F, const details::get_type_t<0, Types...>&>>
+constexpr R common_member(const variant<Types...>& v, F&& f) requires(
+    details::is_common_projection<F, const Types&...>) {
+  if (std::is_constant_evaluated()) {
+    return *visit([&f](const auto& value) { return std::addressof(std::invoke(f, value)); }, v);
+  }
+  return details::project_common<std::remove_cvref_t<F>>(v, f);
+}
+
+#endif
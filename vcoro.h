@@ -0,0 +1,117 @@
+#ifndef VARIANT_CORO_H
+#define VARIANT_CORO_H
+
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+template <typename T>
+struct generator {
+  struct promise_type {
+    generator get_return_object() noexcept {
+      return generator(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+
+    std::suspend_always initial_suspend() const noexcept {
+      return {};
+    }
+
+    std::suspend_always final_suspend() const noexcept {
+      return {};
+    }
+
+    std::suspend_always yield_value(std::remove_reference_t<T>& value) noexcept {
+      current = std::addressof(value);
+      return {};
+    }
+
+    std::suspend_always yield_value(std::remove_reference_t<T>&& value) noexcept {
+      current = std::addressof(value);
+      return {};
+    }
+
+    void return_void() const noexcept {}
+
+    void unhandled_exception() noexcept {
+      exception = std::current_exception();
+    }
+
+    void await_transform() = delete;
+
+    std::remove_reference_t<T>* current = nullptr;
+    std::exception_ptr exception;
+  };
+
+  struct iterator {
+    using iterator_category = std::input_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = std::remove_cvref_t<T>;
+
+    iterator& operator++() {
+      handle.resume();
+      rethrow();
+      return *this;
+    }
+
+    void operator++(int) {
+      ++*this;
+    }
+
+    std::remove_reference_t<T>& operator*() const noexcept {
+      return *handle.promise().current;
+    }
+
+    friend bool operator==(const iterator& it, std::default_sentinel_t) noexcept {
+      return it.handle.done();
+    }
+
+    void rethrow() const {
+      if (handle.done() && handle.promise().exception) {
+        std::rethrow_exception(handle.promise().exception);
+      }
+    }
+
+    std::coroutine_handle<promise_type> handle;
+  };
+
+  generator(generator&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+
+  generator& operator=(generator&& other) noexcept {
+    if (this != &other) {
+      destroy();
+      handle_ = std::exchange(other.handle_, nullptr);
+    }
+    return *this;
+  }
+
+  ~generator() {
+    destroy();
+  }
+
+  iterator begin() {
+    handle_.resume();
+    iterator it{handle_};
+    it.rethrow();
+    return it;
+  }
+
+  std::default_sentinel_t end() const noexcept {
+    return {};
+  }
+
+private:
+  explicit generator(std::coroutine_handle<promise_type> handle) noexcept : handle_(handle) {}
+
+  void destroy() noexcept {
+    if (handle_) {
+      handle_.destroy();
+    }
+  }
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+#endif
@@ -5,6 +5,30 @@
 #include <memory>
 #include <type_traits>
 
+// Defining VARIANT_NO_EXCEPTIONS (implied by -fno-exceptions) makes failed accesses call
+// VARIANT_ACCESS_FAILURE_HANDLER(what) if it is defined, or std::abort() otherwise. The handler must not return;
+// when it is defined it is also used instead of throwing bad_variant_access in builds with exceptions.
+#if !defined(VARIANT_NO_EXCEPTIONS) && !defined(__cpp_exceptions) && !defined(__EXCEPTIONS) && !defined(_CPPUNWIND)
+#define VARIANT_NO_EXCEPTIONS
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define VARIANT_COLD __attribute__((noinline, cold))
+#elif defined(_MSC_VER)
+#define VARIANT_COLD __declspec(noinline)
+#else
+#define VARIANT_COLD
+#endif
+
+// variant.cppm defines these to `export extern "C++" {` and `}` before including the headers in its purview, which
+// exports their declarations while keeping them attached to the global module, so that a program may mix the import
+// with plain includes.
+#ifndef VARIANT_BEGIN_EXPORT
+#define VARIANT_BEGIN_EXPORT
+#define VARIANT_END_EXPORT
+#endif
+
+VARIANT_BEGIN_EXPORT
 struct in_place_t {
   explicit in_place_t() = default;
 };
@@ -27,6 +51,15 @@ struct in_place_type_t {
 template <typename T>
 inline constexpr in_place_type_t<T> in_place_type;
 
+// Selects the variant constructor that builds alternative N from the result of a factory.
+template <size_t N>
+struct in_place_factory_t {
+  explicit in_place_factory_t() = default;
+};
+
+template <size_t N>
+inline constexpr in_place_factory_t<N> in_place_factory;
+
 namespace details {
 template <typename T>
 struct is_in_place_type_t {
@@ -43,6 +76,11 @@ struct is_in_place_type_t<in_place_index_t<N>> {
   static constexpr bool value = true;
 };
 
+template <size_t N>
+struct is_in_place_type_t<in_place_factory_t<N>> {
+  static constexpr bool value = true;
+};
+
 template <typename T>
 inline constexpr bool is_in_place_type_v = is_in_place_type_t<T>::value;
 
@@ -96,5 +134,6 @@ concept is_convertible_to =
     (sizeof...(Types) > 0) && (!std::is_same_v<From, Variant>)&&(std::is_constructible_v<To, From>);
 
 } // namespace details
+VARIANT_END_EXPORT
 
 #endif
@@ -0,0 +1,524 @@
+#ifndef VARIANT_EXPECTED_H
+#define VARIANT_EXPECTED_H
+
+#include "variant.h"
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+template <typename E>
+class unexpected {
+public:
+  template <typename G = E>
+  constexpr explicit unexpected(G&& error) requires(!std::is_same_v<std::remove_cvref_t<G>, unexpected> &&
+                                                   !std::is_same_v<std::remove_cvref_t<G>, in_place_t> &&
+                                                   std::is_constructible_v<E, G>)
+      : error_(std::forward<G>(error)) {}
+
+  template <typename... Args>
+  constexpr explicit unexpected(in_place_t, Args&&... args) requires(std::is_constructible_v<E, Args...>)
+      : error_(std::forward<Args>(args)...) {}
+
+  constexpr E& error() & noexcept {
+    return error_;
+  }
+
+  constexpr const E& error() const& noexcept {
+    return error_;
+  }
+
+  constexpr E&& error() && noexcept {
+    return std::move(error_);
+  }
+
+  constexpr const E&& error() const&& noexcept {
+    return std::move(error_);
+  }
+
+  template <typename G>
+  friend constexpr bool operator==(const unexpected& a, const unexpected<G>& b) {
+    return a.error() == b.error();
+  }
+
+private:
+  E error_;
+};
+
+template <typename E>
+unexpected(E) -> unexpected<E>;
+
+struct unexpect_t {
+  explicit unexpect_t() = default;
+};
+
+inline constexpr unexpect_t unexpect;
+
+template <typename T, typename E>
+class expected;
+
+namespace details {
+template <typename T>
+inline constexpr bool is_expected_v = false;
+
+template <typename T, typename E>
+inline constexpr bool is_expected_v<expected<T, E>> = true;
+
+template <typename T>
+inline constexpr bool is_unexpected_v = false;
+
+template <typename E>
+inline constexpr bool is_unexpected_v<unexpected<E>> = true;
+} // namespace details
+
+// A value or an error in a two-alternative vstorage: the value at index 0, the error at index 1. The one-byte index is
+// only ever tested with a branch, so no access goes through the visit tables, and checked access fails through
+// throw_bad_variant_access, which honours VARIANT_NO_EXCEPTIONS and the access-failure handler.
+//
+// An expected is never valueless: assignments that switch between value and error require both alternatives to be
+// nothrow move constructible and build a throwing copy in a temporary first.
+template <typename T, typename E>
+class expected : private details::vstorage_t<T, E> {
+  static_assert(!std::is_void_v<T> && !std::is_reference_v<T>, "expected holds object values only");
+  static_assert(!details::is_unexpected_v<std::remove_cv_t<T>> && !details::is_unexpected_v<std::remove_cv_t<E>>);
+
+  using base = details::vstorage_t<T, E>;
+
+  template <typename U, typename G>
+  friend class expected;
+
+public:
+  using value_type = T;
+  using error_type = E;
+  using unexpected_type = unexpected<E>;
+
+  template <typename U>
+  using rebind = expected<U, error_type>;
+
+  constexpr expected() noexcept(std::is_nothrow_default_constructible_v<T>) requires(
+      std::is_default_constructible_v<T>)
+      : base(in_place_index<0>) {}
+
+  template <typename U = T>
+  constexpr expected(U&& value) noexcept(std::is_nothrow_constructible_v<T, U>) requires(
+      !std::is_same_v<std::remove_cvref_t<U>, expected> && !std::is_same_v<std::remove_cvref_t<U>, in_place_t> &&
+      !std::is_same_v<std::remove_cvref_t<U>, unexpect_t> && !details::is_unexpected_v<std::remove_cvref_t<U>> &&
+      std::is_constructible_v<T, U>)
+      : base(in_place_index<0>, std::forward<U>(value)) {}
+
+  template <typename G>
+  constexpr expected(const unexpected<G>& error) requires(std::is_constructible_v<E, const G&>)
+      : base(in_place_index<1>, error.error()) {}
+
+  template <typename G>
+  constexpr expected(unexpected<G>&& error) requires(std::is_constructible_v<E, G>)
+      : base(in_place_index<1>, std::move(error).error()) {}
+
+  template <typename... Args>
+  constexpr explicit expected(in_place_t, Args&&... args) requires(std::is_constructible_v<T, Args...>)
+      : base(in_place_index<0>, std::forward<Args>(args)...) {}
+
+  template <typename... Args>
+  constexpr explicit expected(unexpect_t, Args&&... args) requires(std::is_constructible_v<E, Args...>)
+      : base(in_place_index<1>, std::forward<Args>(args)...) {}
+
+  // Interop with variant<T, E>: alternative 0 is the value and alternative 1 the error.
+  template <typename V>
+  constexpr explicit expected(V&& v) requires(std::is_same_v<std::remove_cvref_t<V>, variant<T, E>>)
+      : base(details::undefined) {
+    if (v.index() == 0) {
+      this->set(in_place_index<0>, get<0>(std::forward<V>(v)));
+    } else if (v.index() == 1) {
+      this->set(in_place_index<1>, get<1>(std::forward<V>(v)));
+    } else {
+      details::throw_bad_variant_access();
+    }
+  }
+
+  constexpr expected(const expected&) = delete;
+
+  constexpr expected(const expected& other) requires(details::is_copy_constructible<T, E>)
+      : base(details::undefined) {
+    if (other.has_value()) {
+      this->set(in_place_index<0>, *other);
+    } else {
+      this->set(in_place_index<1>, other.error());
+    }
+  }
+
+  constexpr expected(const expected&) requires(details::is_trivially_copy_constructible<T, E>) = default;
+
+  constexpr expected(expected&&) = delete;
+
+  constexpr expected(expected&& other) noexcept(details::is_nothrow_move_constructible<T, E>) requires(
+      details::is_move_constructible<T, E>)
+      : base(details::undefined) {
+    if (other.has_value()) {
+      this->set(in_place_index<0>, std::move(*other));
+    } else {
+      this->set(in_place_index<1>, std::move(other).error());
+    }
+  }
+
+  constexpr expected(expected&&) noexcept(details::is_nothrow_move_constructible<T, E>) requires(
+      details::is_trivially_move_constructible<T, E>) = default;
+
+  constexpr expected& operator=(const expected&) = delete;
+
+  constexpr expected& operator=(const expected& other) requires(details::is_copy_assignable<T, E> &&
+                                                                details::is_nothrow_move_constructible<T, E>) {
+    if (other.has_value()) {
+      assign<0>(*other);
+    } else {
+      assign<1>(other.error());
+    }
+    return *this;
+  }
+
+  constexpr expected& operator=(const expected&) requires(details::is_trivially_copy_assignable<T, E> &&
+                                                          details::is_nothrow_move_constructible<T, E>) = default;
+
+  constexpr expected& operator=(expected&&) = delete;
+
+  constexpr expected& operator=(expected&& other) noexcept(details::is_nothrow_move_assignable<T, E>) requires(
+      details::is_move_assignable<T, E> && details::is_nothrow_move_constructible<T, E>) {
+    if (other.has_value()) {
+      assign<0>(std::move(*other));
+    } else {
+      assign<1>(std::move(other).error());
+    }
+    return *this;
+  }
+
+  constexpr expected& operator=(expected&&) noexcept(details::is_nothrow_move_assignable<T, E>) requires(
+      details::is_trivially_move_assignable<T, E> && details::is_nothrow_move_constructible<T, E>) = default;
+
+  template <typename U = T>
+  constexpr expected& operator=(U&& value) requires(!std::is_same_v<std::remove_cvref_t<U>, expected> &&
+                                                    !details::is_unexpected_v<std::remove_cvref_t<U>> &&
+                                                    std::is_constructible_v<T, U> && std::is_assignable_v<T&, U> &&
+                                                    details::is_nothrow_move_constructible<T, E>) {
+    assign<0>(std::forward<U>(value));
+    return *this;
+  }
+
+  template <typename G>
+  constexpr expected& operator=(const unexpected<G>& error) requires(
+      std::is_constructible_v<E, const G&> && std::is_assignable_v<E&, const G&> &&
+      details::is_nothrow_move_constructible<T, E>) {
+    assign<1>(error.error());
+    return *this;
+  }
+
+  template <typename G>
+  constexpr expected& operator=(unexpected<G>&& error) requires(
+      std::is_constructible_v<E, G> && std::is_assignable_v<E&, G> && details::is_nothrow_move_constructible<T, E>) {
+    assign<1>(std::move(error).error());
+    return *this;
+  }
+
+  // The base destructor would dispatch through visit_by_index; destroying here leaves it nothing to do.
+  constexpr ~expected() requires(details::is_trivially_destructible<T, E>) = default;
+
+  constexpr ~expected() {
+    destroy();
+    this->index_ = base::npos;
+  }
+
+  template <typename... Args>
+  constexpr T& emplace(Args&&... args) noexcept(std::is_nothrow_constructible_v<T, Args...>) requires(
+      std::is_constructible_v<T, Args...> && details::is_nothrow_move_constructible<T>) {
+    if constexpr (std::is_nothrow_constructible_v<T, Args...>) {
+      destroy();
+      return this->set(in_place_index<0>, std::forward<Args>(args)...);
+    } else {
+      T tmp(std::forward<Args>(args)...);
+      destroy();
+      return this->set(in_place_index<0>, std::move(tmp));
+    }
+  }
+
+  constexpr void swap(expected& other) noexcept(details::is_nothrow_move_constructible<T, E>&&
+                                                    details::is_nothrow_swappable<T, E>) requires(
+      details::is_nothrow_move_constructible<T, E>) {
+    using std::swap;
+    if (has_value() && other.has_value()) {
+      swap(**this, *other);
+    } else if (!has_value() && !other.has_value()) {
+      swap(error(), other.error());
+    } else {
+      expected& with_value = has_value() ? *this : other;
+      expected& with_error = has_value() ? other : *this;
+      T value(std::move(*with_value));
+      with_value.destroy();
+      with_value.set(in_place_index<1>, std::move(with_error).error());
+      with_error.destroy();
+      with_error.set(in_place_index<0>, std::move(value));
+    }
+  }
+
+  friend constexpr void swap(expected& a, expected& b) noexcept(noexcept(a.swap(b))) requires(
+      details::is_nothrow_move_constructible<T, E>) {
+    a.swap(b);
+  }
+
+  constexpr bool has_value() const noexcept {
+    return this->index_ == 0;
+  }
+
+  constexpr explicit operator bool() const noexcept {
+    return has_value();
+  }
+
+  constexpr T* operator->() noexcept {
+    return std::addressof(**this);
+  }
+
+  constexpr const T* operator->() const noexcept {
+    return std::addressof(**this);
+  }
+
+  constexpr T& operator*() & noexcept {
+    return this->storage.get(in_place_index<0>);
+  }
+
+  constexpr const T& operator*() const& noexcept {
+    return this->storage.get(in_place_index<0>);
+  }
+
+  constexpr T&& operator*() && noexcept {
+    return std::move(this->storage.get(in_place_index<0>));
+  }
+
+  constexpr const T&& operator*() const&& noexcept {
+    return std::move(this->storage.get(in_place_index<0>));
+  }
+
+  constexpr T& value() & {
+    check_value();
+    return **this;
+  }
+
+  constexpr const T& value() const& {
+    check_value();
+    return **this;
+  }
+
+  constexpr T&& value() && {
+    check_value();
+    return std::move(**this);
+  }
+
+  constexpr const T&& value() const&& {
+    check_value();
+    return std::move(**this);
+  }
+
+  constexpr E& error() & noexcept {
+    return this->storage.get(in_place_index<1>);
+  }
+
+  constexpr const E& error() const& noexcept {
+    return this->storage.get(in_place_index<1>);
+  }
+
+  constexpr E&& error() && noexcept {
+    return std::move(this->storage.get(in_place_index<1>));
+  }
+
+  constexpr const E&& error() const&& noexcept {
+    return std::move(this->storage.get(in_place_index<1>));
+  }
+
+  template <typename U>
+  constexpr T value_or(U&& fallback) const& {
+    return has_value() ? **this : static_cast<T>(std::forward<U>(fallback));
+  }
+
+  template <typename U>
+  constexpr T value_or(U&& fallback) && {
+    return has_value() ? std::move(**this) : static_cast<T>(std::forward<U>(fallback));
+  }
+
+  template <typename F>
+  constexpr auto and_then(F&& f) & {
+    return and_then_impl(*this, std::forward<F>(f));
+  }
+
+  template <typename F>
+  constexpr auto and_then(F&& f) const& {
+    return and_then_impl(*this, std::forward<F>(f));
+  }
+
+  template <typename F>
+  constexpr auto and_then(F&& f) && {
+    return and_then_impl(std::move(*this), std::forward<F>(f));
+  }
+
+  template <typename F>
+  constexpr auto and_then(F&& f) const&& {
+    return and_then_impl(std::move(*this), std::forward<F>(f));
+  }
+
+  template <typename F>
+  constexpr auto or_else(F&& f) & {
+    return or_else_impl(*this, std::forward<F>(f));
+  }
+
+  template <typename F>
+  constexpr auto or_else(F&& f) const& {
+    return or_else_impl(*this, std::forward<F>(f));
+  }
+
+  template <typename F>
+  constexpr auto or_else(F&& f) && {
+    return or_else_impl(std::move(*this), std::forward<F>(f));
+  }
+
+  template <typename F>
+  constexpr auto or_else(F&& f) const&& {
+    return or_else_impl(std::move(*this), std::forward<F>(f));
+  }
+
+  template <typename F>
+  constexpr auto transform(F&& f) & {
+    return transform_impl(*this, std::forward<F>(f));
+  }
+
+  template <typename F>
+  constexpr auto transform(F&& f) const& {
+    return transform_impl(*this, std::forward<F>(f));
+  }
+
+  template <typename F>
+  constexpr auto transform(F&& f) && {
+    return transform_impl(std::move(*this), std::forward<F>(f));
+  }
+
+  template <typename F>
+  constexpr auto transform(F&& f) const&& {
+    return transform_impl(std::move(*this), std::forward<F>(f));
+  }
+
+  template <typename F>
+  constexpr auto transform_error(F&& f) & {
+    return transform_error_impl(*this, std::forward<F>(f));
+  }
+
+  template <typename F>
+  constexpr auto transform_error(F&& f) const& {
+    return transform_error_impl(*this, std::forward<F>(f));
+  }
+
+  template <typename F>
+  constexpr auto transform_error(F&& f) && {
+    return transform_error_impl(std::move(*this), std::forward<F>(f));
+  }
+
+  template <typename F>
+  constexpr auto transform_error(F&& f) const&& {
+    return transform_error_impl(std::move(*this), std::forward<F>(f));
+  }
+
+  constexpr variant<T, E> to_variant() const& {
+    return has_value() ? variant<T, E>(in_place_index<0>, **this) : variant<T, E>(in_place_index<1>, error());
+  }
+
+  constexpr variant<T, E> to_variant() && {
+    return has_value() ? variant<T, E>(in_place_index<0>, std::move(**this))
+                       : variant<T, E>(in_place_index<1>, std::move(*this).error());
+  }
+
+  template <typename U, typename G>
+  friend constexpr bool operator==(const expected& a, const expected<U, G>& b) {
+    if (a.has_value() != b.has_value()) {
+      return false;
+    }
+    return a.has_value() ? *a == *b : a.error() == b.error();
+  }
+
+  template <typename U>
+  friend constexpr bool operator==(const expected& a, const U& value) requires(
+      !details::is_expected_v<U> && !details::is_unexpected_v<U>) {
+    return a.has_value() && *a == value;
+  }
+
+  template <typename G>
+  friend constexpr bool operator==(const expected& a, const unexpected<G>& error) {
+    return !a.has_value() && a.error() == error.error();
+  }
+
+private:
+  constexpr void check_value() const {
+    if (!has_value()) {
+      details::throw_bad_variant_access("bad expected access");
+    }
+  }
+
+  constexpr void destroy() noexcept {
+    if (has_value()) {
+      this->storage.reset(in_place_index<0>);
+    } else {
+      this->storage.reset(in_place_index<1>);
+    }
+  }
+
+  template <size_t Index, typename U>
+  constexpr void assign(U&& source) {
+    using alternative = details::get_type_t<Index, T, E>;
+    if (this->index_ == Index) {
+      this->storage.get(in_place_index<Index>) = std::forward<U>(source);
+    } else if constexpr (std::is_nothrow_constructible_v<alternative, U>) {
+      destroy();
+      this->set(in_place_index<Index>, std::forward<U>(source));
+    } else {
+      alternative tmp(std::forward<U>(source));
+      destroy();
+      this->set(in_place_index<Index>, std::move(tmp));
+    }
+  }
+
+  template <typename Self, typename F>
+  static constexpr auto and_then_impl(Self&& self, F&& f) {
+    using result = std::remove_cvref_t<std::invoke_result_t<F, decltype(*std::forward<Self>(self))>>;
+    static_assert(details::is_expected_v<result>, "and_then must return an expected");
+    static_assert(std::is_same_v<typename result::error_type, E>, "and_then must keep the error type");
+    if (self.has_value()) {
+      return std::invoke(std::forward<F>(f), *std::forward<Self>(self));
+    }
+    return result(unexpect, std::forward<Self>(self).error());
+  }
+
+  template <typename Self, typename F>
+  static constexpr auto or_else_impl(Self&& self, F&& f) {
+    using result = std::remove_cvref_t<std::invoke_result_t<F, decltype(std::forward<Self>(self).error())>>;
+    static_assert(details::is_expected_v<result>, "or_else must return an expected");
+    static_assert(std::is_same_v<typename result::value_type, T>, "or_else must keep the value type");
+    if (self.has_value()) {
+      return result(in_place, *std::forward<Self>(self));
+    }
+    return std::invoke(std::forward<F>(f), std::forward<Self>(self).error());
+  }
+
+  template <typename Self, typename F>
+  static constexpr auto transform_impl(Self&& self, F&& f) {
+    using value = std::remove_cv_t<std::invoke_result_t<F, decltype(*std::forward<Self>(self))>>;
+    using result = expected<value, E>;
+    if (self.has_value()) {
+      return result(in_place, std::invoke(std::forward<F>(f), *std::forward<Self>(self)));
+    }
+    return result(unexpect, std::forward<Self>(self).error());
+  }
+
+  template <typename Self, typename F>
+  static constexpr auto transform_error_impl(Self&& self, F&& f) {
+    using error = std::remove_cv_t<std::invoke_result_t<F, decltype(std::forward<Self>(self).error())>>;
+    using result = expected<T, error>;
+    if (self.has_value()) {
+      return result(in_place, *std::forward<Self>(self));
+    }
+    return result(unexpect, std::invoke(std::forward<F>(f), std::forward<Self>(self).error()));
+  }
+};
+
+#endif
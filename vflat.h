@@ -0,0 +1,183 @@
+#ifndef VARIANT_FLAT_H
+#define VARIANT_FLAT_H
+
+#include "variant.h"
+#include "vref.h"
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+// Nested variants such as variant<variant<A, B>, variant<C, D>, E> keep a tag per level and dispatch once per level.
+// flat_variant_t of it is variant<A, B, C, D, E>, the leaves in order; flatten and unflatten convert between the two
+// shapes with the index mapping worked out at compile time, and visit_nested visits a flat variant with a visitor
+// written for the nested shape in a single dispatch.
+
+namespace details {
+template <typename... Lists>
+struct flat_concat;
+
+template <typename... Types>
+struct flat_concat<variant<Types...>> {
+  using type = variant<Types...>;
+};
+
+template <typename... A, typename... B, typename... Rest>
+struct flat_concat<variant<A...>, variant<B...>, Rest...> : flat_concat<variant<A..., B...>, Rest...> {};
+
+template <typename T>
+struct flat_leaves {
+  using type = variant<T>;
+};
+
+template <typename... Types>
+struct flat_leaves<variant<Types...>> : flat_concat<typename flat_leaves<Types>::type...> {};
+
+template <typename T>
+inline constexpr size_t leaf_count_v = 1;
+
+template <typename... Types>
+inline constexpr size_t leaf_count_v<variant<Types...>> = (leaf_count_v<Types> + ...);
+
+template <typename Variant>
+struct leaf_layout;
+
+template <typename... Types>
+struct leaf_layout<variant<Types...>> {
+  static constexpr size_t counts[] = {leaf_count_v<Types>...};
+
+  // The flat index of the first leaf of alternative Index.
+  static constexpr size_t offset(size_t index) {
+    size_t result = 0;
+    for (size_t i = 0; i < index; ++i) {
+      result += counts[i];
+    }
+    return result;
+  }
+
+  // The alternative whose leaves include the leaf at flat index Flat.
+  static constexpr size_t group(size_t flat) {
+    size_t i = 0;
+    while (flat >= offset(i + 1)) {
+      ++i;
+    }
+    return i;
+  }
+};
+
+template <typename Variant>
+inline constexpr bool is_innermost_v = false;
+
+template <typename... Types>
+inline constexpr bool is_innermost_v<variant<Types...>> = (!is_variant_v<Types> && ...);
+
+template <typename Group, bool Const>
+struct group_view;
+
+template <typename... Types>
+struct group_view<variant<Types...>, false> {
+  using type = variant_ref<Types...>;
+};
+
+template <typename... Types>
+struct group_view<variant<Types...>, true> {
+  using type = variant_cref<Types...>;
+};
+
+template <typename Flat, size_t Offset, typename Nested>
+constexpr Flat flatten_to(Nested&& nested) {
+  using nested_t = std::remove_cvref_t<Nested>;
+  if (nested.valueless_by_exception()) {
+    throw_bad_variant_access();
+  }
+  return visit_by_index(
+      [&nested](auto index) {
+        using alternative_t = variant_alternative_t<index, nested_t>;
+        constexpr size_t at = Offset + leaf_layout<nested_t>::offset(index);
+        if constexpr (is_variant_v<alternative_t>) {
+          return flatten_to<Flat, at>(get<index>(std::forward<Nested>(nested)));
+        } else {
+          return Flat(in_place_index<at>, get<index>(std::forward<Nested>(nested)));
+        }
+      },
+      nested);
+}
+
+template <typename Nested, size_t Flat, typename Leaf>
+constexpr Nested make_nested(Leaf&& leaf) {
+  constexpr size_t group = leaf_layout<Nested>::group(Flat);
+  using alternative_t = variant_alternative_t<group, Nested>;
+  if constexpr (is_variant_v<alternative_t>) {
+    return Nested(in_place_factory<group>, [&leaf] {
+      return make_nested<alternative_t, Flat - leaf_layout<Nested>::offset(group)>(std::forward<Leaf>(leaf));
+    });
+  } else {
+    return Nested(in_place_index<group>, std::forward<Leaf>(leaf));
+  }
+}
+
+// Calls the visitor with the leaf, or, inside an innermost group it cannot take the leaf of, with a view of the group.
+template <typename Nested, size_t Flat, typename Visitor, typename Leaf>
+constexpr decltype(auto) visit_leaf(Visitor&& visitor, Leaf&& leaf) {
+  constexpr size_t group = leaf_layout<Nested>::group(Flat);
+  constexpr size_t inner = Flat - leaf_layout<Nested>::offset(group);
+  using alternative_t = variant_alternative_t<group, Nested>;
+  if constexpr (!is_variant_v<alternative_t>) {
+    return std::invoke(std::forward<Visitor>(visitor), std::forward<Leaf>(leaf));
+  } else if constexpr (!is_innermost_v<alternative_t>) {
+    return visit_leaf<alternative_t, inner>(std::forward<Visitor>(visitor), std::forward<Leaf>(leaf));
+  } else if constexpr (std::is_invocable_v<Visitor, Leaf>) {
+    return std::invoke(std::forward<Visitor>(visitor), std::forward<Leaf>(leaf));
+  } else {
+    using view_t = typename group_view<alternative_t, std::is_const_v<std::remove_reference_t<Leaf>>>::type;
+    return std::invoke(std::forward<Visitor>(visitor), view_t(in_place_index<inner>, leaf));
+  }
+}
+} // namespace details
+
+template <typename Nested>
+struct flat_variant : details::flat_leaves<Nested> {};
+
+template <typename Nested>
+using flat_variant_t = typename flat_variant<Nested>::type;
+
+// The flat index of the leaf at Path in Nested, e.g. flat_index_v<variant<variant<A, B>, C>, 0, 1> is 1 (B).
+template <typename Nested, size_t Index, size_t... Path>
+inline constexpr size_t flat_index_v =
+    details::leaf_layout<Nested>::offset(Index) + flat_index_v<variant_alternative_t<Index, Nested>, Path...>;
+
+template <typename Nested, size_t Index>
+inline constexpr size_t flat_index_v<Nested, Index> = details::leaf_layout<Nested>::offset(Index);
+
+template <typename Nested>
+constexpr flat_variant_t<std::remove_cvref_t<Nested>> flatten(Nested&& nested) requires(
+    details::is_variant_v<std::remove_cvref_t<Nested>>) {
+  return details::flatten_to<flat_variant_t<std::remove_cvref_t<Nested>>, 0>(std::forward<Nested>(nested));
+}
+
+template <typename Nested, typename Flat>
+constexpr Nested unflatten(Flat&& flat) requires(std::is_same_v<std::remove_cvref_t<Flat>, flat_variant_t<Nested>>) {
+  if (flat.valueless_by_exception()) {
+    details::throw_bad_variant_access();
+  }
+  return details::visit_by_index(
+      [&flat](auto index) { return details::make_nested<Nested, index>(get<index>(std::forward<Flat>(flat))); }, flat);
+}
+
+// Visits a flattened Nested with a single dispatch. The visitor is called with the leaf, except in an innermost group
+// (a nested variant of plain types) when it does not accept the leaf: then it gets a variant_ref, or a variant_cref
+// for a const flat variant, of the group, so that a handler can take a whole group such as
+// `[](variant_cref<C, D> g) { ... }`.
+template <typename Nested, typename Visitor, typename Flat>
+constexpr decltype(auto) visit_nested(Visitor&& visitor, Flat&& flat) requires(
+    std::is_same_v<std::remove_cvref_t<Flat>, flat_variant_t<Nested>>) {
+  if (flat.valueless_by_exception()) {
+    details::throw_bad_variant_access();
+  }
+  return details::visit_by_index(
+      [&](auto index) -> decltype(auto) {
+        return details::visit_leaf<Nested, index>(std::forward<Visitor>(visitor), get<index>(std::forward<Flat>(flat)));
+      },
+      flat);
+}
+
+#endif
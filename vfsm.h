@@ -0,0 +1,134 @@
+#ifndef VARIANT_FSM_H
+#define VARIANT_FSM_H
+
+#include "variant.h"
+#include <array>
+#include <functional>
+#include <tuple>
+#include <utility>
+
+template <typename State, typename... Args>
+struct enter {
+  template <typename... Ts>
+  constexpr explicit enter(Ts&&... ts) : args(std::forward<Ts>(ts)...) {}
+
+  std::tuple<Args...> args;
+};
+
+template <typename State, typename... Ts>
+constexpr enter<State, std::decay_t<Ts>...> enter_state(Ts&&... ts) {
+  return enter<State, std::decay_t<Ts>...>(std::forward<Ts>(ts)...);
+}
+
+namespace details {
+template <typename T>
+struct is_enter : std::false_type {};
+
+template <typename State, typename... Args>
+struct is_enter<enter<State, Args...>> : std::true_type {};
+} // namespace details
+
+template <typename States, typename Events, typename Transitions>
+struct state_machine;
+
+// Transitions is an overload set of (State&, const Event&) handlers. A handler returning void keeps the current
+// state, returning one of States moves it into place and returning enter<State, Args...> constructs the next state
+// directly from Args. Pairs without a handler are ignored.
+template <typename... States, typename... Events, typename Transitions>
+struct state_machine<variant<States...>, variant<Events...>, Transitions> {
+  using state_type = variant<States...>;
+  using event_type = variant<Events...>;
+
+  template <typename... Args>
+  constexpr explicit state_machine(Transitions transitions, Args&&... args)
+      : transitions_(std::move(transitions)), state_(std::forward<Args>(args)...) {}
+
+  constexpr const state_type& state() const noexcept {
+    return state_;
+  }
+
+  template <typename T>
+  constexpr bool is() const noexcept {
+    return holds_alternative<T>(state_);
+  }
+
+  constexpr void dispatch(const event_type& event) {
+    if (state_.valueless_by_exception() || event.valueless_by_exception()) {
+      details::throw_bad_variant_access();
+    }
+    flat_table_v<std::make_index_sequence<sizeof...(States) * sizeof...(Events)>>[state_.index() * sizeof...(Events) +
+                                                                                  event.index()](*this, event);
+  }
+
+  template <typename Event>
+  constexpr void dispatch(const Event& event) requires(details::count_of_v<Event, Events...> == 1) {
+    if (state_.valueless_by_exception()) {
+      details::throw_bad_variant_access();
+    }
+    state_table_v<Event, std::make_index_sequence<sizeof...(States)>>[state_.index()](*this, event);
+  }
+
+private:
+  template <size_t StateIndex, typename Event>
+  constexpr void handle(const Event& event) {
+    using state_t = details::get_type_t<StateIndex, States...>;
+    if constexpr (std::is_invocable_v<Transitions&, state_t&, const Event&>) {
+      using result_t = std::invoke_result_t<Transitions&, state_t&, const Event&>;
+      if constexpr (std::is_void_v<result_t>) {
+        std::invoke(transitions_, get<StateIndex>(state_), event);
+      } else if constexpr (details::is_enter<result_t>::value) {
+        apply_enter(std::invoke(transitions_, get<StateIndex>(state_), event));
+      } else {
+        static_assert(details::count_of_v<result_t, States...> == 1, "transition must return one of the states");
+        state_.template emplace<details::find_first_v<result_t, States...>>(
+            std::invoke(transitions_, get<StateIndex>(state_), event));
+      }
+    }
+  }
+
+  template <typename State, typename... Args>
+  constexpr void apply_enter(enter<State, Args...>&& next) {
+    static_assert(details::count_of_v<State, States...> == 1, "transition must enter one of the states");
+    std::apply(
+        [this](Args&... args) { state_.template emplace<details::find_first_v<State, States...>>(std::move(args)...); },
+        next.args);
+  }
+
+  template <typename Sequence>
+  struct flat_table;
+
+  // One entry per (state, event) pair, indexed by state * sizeof...(Events) + event.
+  template <size_t... Flat>
+  struct flat_table<std::index_sequence<Flat...>> {
+    static constexpr std::array<void (*)(state_machine&, const event_type&), sizeof...(Flat)> value = {
+        [](state_machine& self, const event_type& event) {
+          self.template handle<Flat / sizeof...(Events)>(get<Flat % sizeof...(Events)>(event));
+        }...};
+  };
+
+  template <typename Sequence>
+  static constexpr auto flat_table_v = flat_table<Sequence>::value;
+
+  template <typename Event, typename Sequence>
+  struct state_table;
+
+  template <typename Event, size_t... Is>
+  struct state_table<Event, std::index_sequence<Is...>> {
+    static constexpr std::array<void (*)(state_machine&, const Event&), sizeof...(Is)> value = {
+        [](state_machine& self, const Event& event) { self.template handle<Is>(event); }...};
+  };
+
+  template <typename Event, typename Sequence>
+  static constexpr auto state_table_v = state_table<Event, Sequence>::value;
+
+  [[no_unique_address]] Transitions transitions_;
+  state_type state_;
+};
+
+template <typename States, typename Events, typename Transitions, typename... Args>
+constexpr auto make_state_machine(Transitions&& transitions, Args&&... args) {
+  return state_machine<States, Events, std::decay_t<Transitions>>(std::forward<Transitions>(transitions),
+                                                                   std::forward<Args>(args)...);
+}
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef VARIANT_HASH_H
+#define VARIANT_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Hashing shared by the variant-keyed containers: the hash of an alternative value, and the mix that combines it with
+// the alternative index so that equal values of different alternatives land apart.
+
+struct variant_key_hash {
+  template <typename T>
+  size_t operator()(const T& value) const noexcept(noexcept(std::hash<T>{}(value))) {
+    return std::hash<T>{}(value);
+  }
+};
+
+namespace details {
+constexpr uint64_t hash_mix(uint64_t hash, size_t index) noexcept {
+  hash ^= (index + 1) * 0x9E3779B97F4A7C15ull;
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDull;
+  hash ^= hash >> 33;
+  hash *= 0xC4CEB9FE1A85EC53ull;
+  hash ^= hash >> 33;
+  return hash;
+}
+} // namespace details
+
+#endif
@@ -0,0 +1,502 @@
+#ifndef VARIANT_HASH_MAP_H
+#define VARIANT_HASH_MAP_H
+
+#include "variant.h"
+#include "vhash.h"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+#if !defined(VARIANT_HASH_MAP_NO_SIMD) &&                                                                              \
+    (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define VARIANT_HASH_MAP_SSE2
+#endif
+
+// Open-addressing map keyed by a variant, laid out like a Swiss table: one control byte per slot holds either an
+// empty/deleted marker or 7 bits of the key hash, and lookups compare a group of 16 control bytes at once. The hash of
+// a key is the hash of its active alternative mixed with the alternative index, so lookups by a bare alternative
+// value hash and compare it directly without constructing a variant, and only slots holding that alternative are
+// ever compared.
+
+namespace details {
+inline constexpr size_t hash_group_width = 16;
+
+enum class hash_ctrl : int8_t { empty = -128, deleted = -2 };
+
+struct hash_group {
+  explicit hash_group(const int8_t* ctrl) noexcept {
+#ifdef VARIANT_HASH_MAP_SSE2
+    bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+#else
+    std::memcpy(bytes, ctrl, hash_group_width);
+#endif
+  }
+
+  uint32_t match(int8_t value) const noexcept {
+#ifdef VARIANT_HASH_MAP_SSE2
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(value), bytes)));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < hash_group_width; ++i) {
+      mask |= uint32_t(bytes[i] == value) << i;
+    }
+    return mask;
+#endif
+  }
+
+  uint32_t match_empty() const noexcept {
+    return match(static_cast<int8_t>(hash_ctrl::empty));
+  }
+
+  // Empty and deleted control bytes are the only negative ones.
+  uint32_t match_free() const noexcept {
+#ifdef VARIANT_HASH_MAP_SSE2
+    return static_cast<uint32_t>(_mm_movemask_epi8(bytes));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < hash_group_width; ++i) {
+      mask |= uint32_t(bytes[i] < 0) << i;
+    }
+    return mask;
+#endif
+  }
+
+#ifdef VARIANT_HASH_MAP_SSE2
+  __m128i bytes;
+#else
+  int8_t bytes[hash_group_width];
+#endif
+};
+} // namespace details
+
+template <typename Key, typename Value, typename Hash = variant_key_hash>
+class variant_hash_map;
+
+template <typename... Types, typename Value, typename Hash>
+class variant_hash_map<variant<Types...>, Value, Hash> {
+  template <typename T>
+  static constexpr bool is_alternative = details::count_of_v<T, Types...> == 1;
+
+public:
+  using key_type = variant<Types...>;
+  using mapped_type = Value;
+  using value_type = std::pair<const key_type, Value>;
+  using size_type = size_t;
+  using hasher = Hash;
+
+  template <bool Const>
+  class basic_iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = variant_hash_map::value_type;
+    using reference = std::conditional_t<Const, const value_type&, value_type&>;
+    using pointer = std::conditional_t<Const, const value_type*, value_type*>;
+
+    basic_iterator() noexcept = default;
+
+    template <bool OtherConst>
+    basic_iterator(const basic_iterator<OtherConst>& other) noexcept requires(Const && !OtherConst)
+        : map_(other.map_), slot_(other.slot_) {}
+
+    reference operator*() const noexcept {
+      return *map_->slot(slot_);
+    }
+
+    pointer operator->() const noexcept {
+      return map_->slot(slot_);
+    }
+
+    basic_iterator& operator++() noexcept {
+      slot_ = map_->next_full(slot_ + 1);
+      return *this;
+    }
+
+    basic_iterator operator++(int) noexcept {
+      basic_iterator result = *this;
+      ++*this;
+      return result;
+    }
+
+    friend bool operator==(const basic_iterator& lhs, const basic_iterator& rhs) noexcept {
+      return lhs.slot_ == rhs.slot_;
+    }
+
+  private:
+    friend class variant_hash_map;
+    template <bool>
+    friend class basic_iterator;
+
+    using map_pointer = std::conditional_t<Const, const variant_hash_map*, variant_hash_map*>;
+
+    basic_iterator(map_pointer map, size_t slot) noexcept : map_(map), slot_(slot) {}
+
+    map_pointer map_ = nullptr;
+    size_t slot_ = 0;
+  };
+
+  using iterator = basic_iterator<false>;
+  using const_iterator = basic_iterator<true>;
+
+  variant_hash_map() = default;
+
+  explicit variant_hash_map(size_t capacity, Hash hash = Hash()) : hash_(std::move(hash)) {
+    reserve(capacity);
+  }
+
+  variant_hash_map(const variant_hash_map& other) : hash_(other.hash_) {
+    reserve(other.size_);
+    for (const value_type& value : other) {
+      insert_unique(hash_key(value.first), std::forward_as_tuple(value.first), value.second);
+    }
+  }
+
+  variant_hash_map(variant_hash_map&& other) noexcept
+      : hash_(std::move(other.hash_)), ctrl_(std::move(other.ctrl_)), slots_(std::exchange(other.slots_, nullptr)),
+        capacity_(std::exchange(other.capacity_, 0)), size_(std::exchange(other.size_, 0)),
+        growth_left_(std::exchange(other.growth_left_, 0)) {}
+
+  variant_hash_map& operator=(variant_hash_map other) noexcept {
+    swap(other);
+    return *this;
+  }
+
+  ~variant_hash_map() {
+    destroy();
+  }
+
+  void swap(variant_hash_map& other) noexcept {
+    using std::swap;
+    swap(hash_, other.hash_);
+    swap(ctrl_, other.ctrl_);
+    swap(slots_, other.slots_);
+    swap(capacity_, other.capacity_);
+    swap(size_, other.size_);
+    swap(growth_left_, other.growth_left_);
+  }
+
+  size_t size() const noexcept {
+    return size_;
+  }
+
+  bool empty() const noexcept {
+    return size_ == 0;
+  }
+
+  size_t capacity() const noexcept {
+    return capacity_;
+  }
+
+  iterator begin() noexcept {
+    return iterator(this, next_full(0));
+  }
+
+  iterator end() noexcept {
+    return iterator(this, capacity_);
+  }
+
+  const_iterator begin() const noexcept {
+    return const_iterator(this, next_full(0));
+  }
+
+  const_iterator end() const noexcept {
+    return const_iterator(this, capacity_);
+  }
+
+  void clear() noexcept {
+    destroy();
+    size_ = 0;
+    capacity_ = 0;
+    growth_left_ = 0;
+  }
+
+  void reserve(size_t count) {
+    if (count > max_load(capacity_)) {
+      rehash(std::bit_ceil(std::max(count + count / 7 + 1, details::hash_group_width)));
+    }
+  }
+
+  iterator find(const key_type& key) {
+    return iterator(this, find_slot(key));
+  }
+
+  const_iterator find(const key_type& key) const {
+    return const_iterator(this, find_slot(key));
+  }
+
+  template <typename T>
+  iterator find(const T& value) requires(is_alternative<T>) {
+    return iterator(this, find_slot<details::find_first_v<T, Types...>>(value));
+  }
+
+  template <typename T>
+  const_iterator find(const T& value) const requires(is_alternative<T>) {
+    return const_iterator(this, find_slot<details::find_first_v<T, Types...>>(value));
+  }
+
+  // Lookup by a value that hashes and compares like alternative Index, e.g. std::string_view for std::string.
+  template <size_t Index, typename U>
+  iterator find(in_place_index_t<Index>, const U& value) requires(Index < sizeof...(Types)) {
+    return iterator(this, find_slot<Index>(value));
+  }
+
+  template <size_t Index, typename U>
+  const_iterator find(in_place_index_t<Index>, const U& value) const requires(Index < sizeof...(Types)) {
+    return const_iterator(this, find_slot<Index>(value));
+  }
+
+  template <typename K>
+  bool contains(const K& key) const requires(std::is_same_v<K, key_type> || is_alternative<K>) {
+    return find(key) != end();
+  }
+
+  template <typename K>
+  size_t count(const K& key) const requires(std::is_same_v<K, key_type> || is_alternative<K>) {
+    return contains(key) ? 1 : 0;
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(const key_type& key, Args&&... args) {
+    return emplace_key(key, std::forward_as_tuple(key), std::forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(key_type&& key, Args&&... args) {
+    return emplace_key(key, std::forward_as_tuple(std::move(key)), std::forward<Args>(args)...);
+  }
+
+  // The key variant is only constructed when the alternative value is not present yet.
+  template <typename T, typename... Args>
+  std::pair<iterator, bool> try_emplace(T&& value, Args&&... args) requires(is_alternative<std::remove_cvref_t<T>>) {
+    constexpr size_t index = details::find_first_v<std::remove_cvref_t<T>, Types...>;
+    uint64_t hash = hash_alternative<index>(value);
+    if (size_t i = find_slot<index>(value); i != capacity_) {
+      return {iterator(this, i), false};
+    }
+    return {insert_unique(hash, std::forward_as_tuple(in_place_index<index>, std::forward<T>(value)),
+                          std::forward<Args>(args)...),
+            true};
+  }
+
+  std::pair<iterator, bool> insert(const value_type& value) {
+    return try_emplace(value.first, value.second);
+  }
+
+  std::pair<iterator, bool> insert(value_type&& value) {
+    return try_emplace(value.first, std::move(value.second));
+  }
+
+  template <typename K>
+  Value& operator[](K&& key) requires(std::is_same_v<std::remove_cvref_t<K>, key_type> ||
+                                      is_alternative<std::remove_cvref_t<K>>) {
+    return try_emplace(std::forward<K>(key)).first->second;
+  }
+
+  template <typename K>
+  Value& at(const K& key) requires(std::is_same_v<K, key_type> || is_alternative<K>) {
+    auto it = find(key);
+    if (it == end()) {
+      throw std::out_of_range("key is not in variant_hash_map");
+    }
+    return it->second;
+  }
+
+  template <typename K>
+  const Value& at(const K& key) const requires(std::is_same_v<K, key_type> || is_alternative<K>) {
+    auto it = find(key);
+    if (it == end()) {
+      throw std::out_of_range("key is not in variant_hash_map");
+    }
+    return it->second;
+  }
+
+  iterator erase(const_iterator pos) noexcept {
+    erase_slot(pos.slot_);
+    return iterator(this, next_full(pos.slot_ + 1));
+  }
+
+  iterator erase(iterator pos) noexcept {
+    return erase(const_iterator(pos));
+  }
+
+  template <typename K>
+  size_t erase(const K& key) requires(std::is_same_v<K, key_type> || is_alternative<K>) {
+    auto it = find(key);
+    if (it == end()) {
+      return 0;
+    }
+    erase_slot(it.slot_);
+    return 1;
+  }
+
+private:
+  static constexpr size_t max_load(size_t capacity) noexcept {
+    return capacity - capacity / 8;
+  }
+
+  static constexpr int8_t fingerprint(uint64_t hash) noexcept {
+    return static_cast<int8_t>(hash & 0x7F);
+  }
+
+  value_type* slot(size_t i) const noexcept {
+    return std::launder(reinterpret_cast<value_type*>(slots_ + i * sizeof(value_type)));
+  }
+
+  size_t next_full(size_t i) const noexcept {
+    while (i < capacity_ && ctrl_[i] < 0) {
+      ++i;
+    }
+    return i;
+  }
+
+  template <size_t Index, typename U>
+  uint64_t hash_alternative(const U& value) const {
+    return details::hash_mix(hash_(value), Index);
+  }
+
+  uint64_t hash_key(const key_type& key) const {
+    if (key.valueless_by_exception()) {
+      details::throw_bad_variant_access();
+    }
+    return details::visit_by_index([this, &key](auto index) { return hash_alternative<index>(get<index>(key)); },
+                                   key);
+  }
+
+  // Walks the probe sequence of hash over whole groups (triangular steps visit every group of a power-of-two table)
+  // and calls f with each slot whose fingerprint matches; stops when f returns true or an empty slot is seen.
+  template <typename F>
+  size_t probe(uint64_t hash, F&& f) const {
+    if (capacity_ == 0) {
+      return capacity_;
+    }
+    size_t groups_mask = capacity_ / details::hash_group_width - 1;
+    size_t group = (hash >> 7) & groups_mask;
+    for (size_t step = 1;; ++step) {
+      size_t base = group * details::hash_group_width;
+      details::hash_group g(ctrl_.get() + base);
+      for (uint32_t mask = g.match(fingerprint(hash)); mask != 0; mask &= mask - 1) {
+        size_t i = base + std::countr_zero(mask);
+        if (f(i)) {
+          return i;
+        }
+      }
+      if (g.match_empty() != 0 || step > groups_mask) {
+        return capacity_;
+      }
+      group = (group + step) & groups_mask;
+    }
+  }
+
+  size_t find_slot(const key_type& key) const {
+    if (key.valueless_by_exception()) {
+      return capacity_;
+    }
+    return details::visit_by_index([this, &key](auto index) { return find_slot<index>(get<index>(key)); }, key);
+  }
+
+  template <size_t Index, typename U>
+  size_t find_slot(const U& value) const {
+    return probe(hash_alternative<Index>(value), [this, &value](size_t i) {
+      const key_type& key = slot(i)->first;
+      return key.index() == Index && get<Index>(key) == value;
+    });
+  }
+
+  size_t free_slot(uint64_t hash) const noexcept {
+    size_t groups_mask = capacity_ / details::hash_group_width - 1;
+    size_t group = (hash >> 7) & groups_mask;
+    for (size_t step = 1;; ++step) {
+      size_t base = group * details::hash_group_width;
+      uint32_t mask = details::hash_group(ctrl_.get() + base).match_free();
+      if (mask != 0) {
+        return base + std::countr_zero(mask);
+      }
+      group = (group + step) & groups_mask;
+    }
+  }
+
+  template <typename... KeyArgs, typename... Args>
+  iterator insert_unique(uint64_t hash, std::tuple<KeyArgs...> key_args, Args&&... args) {
+    if (growth_left_ == 0) {
+      // Rehashing in place is enough when most of the used slots are tombstones left by erase.
+      size_t capacity = capacity_ == 0 ? details::hash_group_width : capacity_;
+      rehash(size_ * 2 < max_load(capacity) ? capacity : capacity * 2);
+    }
+    size_t i = free_slot(hash);
+    std::construct_at(slot(i), std::piecewise_construct, std::move(key_args),
+                      std::forward_as_tuple(std::forward<Args>(args)...));
+    if (ctrl_[i] == static_cast<int8_t>(details::hash_ctrl::empty)) {
+      --growth_left_;
+    }
+    ctrl_[i] = fingerprint(hash);
+    ++size_;
+    return iterator(this, i);
+  }
+
+  template <typename KeyArg, typename... Args>
+  std::pair<iterator, bool> emplace_key(const key_type& key, std::tuple<KeyArg> key_arg, Args&&... args) {
+    uint64_t hash = hash_key(key);
+    if (size_t i = find_slot(key); i != capacity_) {
+      return {iterator(this, i), false};
+    }
+    return {insert_unique(hash, std::move(key_arg), std::forward<Args>(args)...), true};
+  }
+
+  void erase_slot(size_t i) noexcept {
+    std::destroy_at(slot(i));
+    // A slot in a group that still has an empty byte can become empty again: no probe sequence continues past it.
+    size_t base = i - i % details::hash_group_width;
+    if (details::hash_group(ctrl_.get() + base).match_empty() != 0) {
+      ctrl_[i] = static_cast<int8_t>(details::hash_ctrl::empty);
+      ++growth_left_;
+    } else {
+      ctrl_[i] = static_cast<int8_t>(details::hash_ctrl::deleted);
+    }
+    --size_;
+  }
+
+  void rehash(size_t capacity) {
+    variant_hash_map fresh;
+    fresh.hash_ = hash_;
+    fresh.ctrl_ = std::make_unique<int8_t[]>(capacity);
+    std::memset(fresh.ctrl_.get(), static_cast<int8_t>(details::hash_ctrl::empty), capacity);
+    fresh.slots_ = static_cast<std::byte*>(::operator new(capacity * sizeof(value_type),
+                                                          std::align_val_t(alignof(value_type))));
+    fresh.capacity_ = capacity;
+    fresh.growth_left_ = max_load(capacity);
+    for (size_t i = next_full(0); i < capacity_; i = next_full(i + 1)) {
+      value_type* old = slot(i);
+      fresh.insert_unique(hash_key(old->first), std::forward_as_tuple(old->first), std::move(old->second));
+    }
+    swap(fresh);
+  }
+
+  void destroy() noexcept {
+    for (size_t i = next_full(0); i < capacity_; i = next_full(i + 1)) {
+      std::destroy_at(slot(i));
+    }
+    if (slots_ != nullptr) {
+      ::operator delete(slots_, std::align_val_t(alignof(value_type)));
+      slots_ = nullptr;
+    }
+    ctrl_.reset();
+  }
+
+  [[no_unique_address]] Hash hash_;
+  std::unique_ptr<int8_t[]> ctrl_;
+  std::byte* slots_ = nullptr;
+  size_t capacity_ = 0;
+  size_t size_ = 0;
+  size_t growth_left_ = 0;
+};
+
+#endif
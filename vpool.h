@@ -0,0 +1,244 @@
+#ifndef VARIANT_POOL_H
+#define VARIANT_POOL_H
+
+#include "variant.h"
+#include "vhash.h"
+#include "vref.h"
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+
+// A compact reference to a value interned in a variant_pool: the alternative index and the slot of the value among the
+// interned values of that alternative. Two handles from the same pool are equal exactly when the values are, so
+// comparing and hashing them never looks at the values.
+template <typename... Types>
+class pool_handle {
+public:
+  using index_type = details::variant_index_t<sizeof...(Types)>;
+
+  constexpr pool_handle() noexcept = default;
+
+  constexpr pool_handle(size_t index, uint32_t slot) noexcept : slot_(slot), index_(static_cast<index_type>(index)) {}
+
+  constexpr size_t index() const noexcept {
+    return size_t(index_type(index_ + 1)) - 1;
+  }
+
+  constexpr uint32_t slot() const noexcept {
+    return slot_;
+  }
+
+  constexpr bool valueless_by_exception() const noexcept {
+    return index() == variant_npos;
+  }
+
+  friend constexpr bool operator==(pool_handle a, pool_handle b) noexcept {
+    return a.slot_ == b.slot_ && a.index_ == b.index_;
+  }
+
+  friend constexpr bool operator!=(pool_handle a, pool_handle b) noexcept {
+    return !(a == b);
+  }
+
+private:
+  uint32_t slot_ = 0;
+  index_type index_ = index_type(-1);
+};
+
+template <typename... Types>
+struct std::hash<pool_handle<Types...>> {
+  size_t operator()(pool_handle<Types...> h) const noexcept {
+    return details::hash_mix(h.slot(), h.index());
+  }
+};
+
+namespace details {
+// The interned values of one alternative. Values live in chunks that double in size and never move, so a handle can
+// be dereferenced without locking while other threads insert. The dedup index is split into shards, each behind its
+// own reader-writer lock; a new value takes the alternative-wide lock only to be constructed into the next slot.
+template <typename T, typename Hash>
+class intern_table {
+  static_assert(std::is_nothrow_move_constructible_v<T>, "interned values are moved into place once constructed");
+
+  static constexpr size_t first_chunk = 64;
+  static constexpr size_t chunks = 32;
+  static constexpr size_t shards = 16;
+
+  struct value_hash {
+    size_t operator()(std::reference_wrapper<const T> value) const {
+      return Hash{}(value.get());
+    }
+  };
+
+  struct value_equal {
+    bool operator()(std::reference_wrapper<const T> a, std::reference_wrapper<const T> b) const {
+      return a.get() == b.get();
+    }
+  };
+
+  struct shard {
+    mutable std::shared_mutex mutex;
+    std::unordered_map<std::reference_wrapper<const T>, uint32_t, value_hash, value_equal> slots;
+  };
+
+public:
+  intern_table() = default;
+
+  intern_table(const intern_table&) = delete;
+  intern_table& operator=(const intern_table&) = delete;
+
+  ~intern_table() {
+    size_t count = size_.load(std::memory_order_relaxed);
+    for (size_t slot = 0; slot < count; ++slot) {
+      std::destroy_at(std::addressof((*this)[uint32_t(slot)]));
+    }
+    for (size_t k = 0; k < chunks && chunks_[k] != nullptr; ++k) {
+      std::allocator<T>().deallocate(chunks_[k], first_chunk << k);
+    }
+  }
+
+  template <typename U>
+  uint32_t intern(U&& value) requires(std::is_same_v<std::remove_cvref_t<U>, T>) {
+    size_t hash = Hash{}(std::as_const(value));
+    shard& s = shards_[hash_mix(hash, 0) >> 60];
+    {
+      std::shared_lock lock(s.mutex);
+      if (auto it = s.slots.find(std::cref(std::as_const(value))); it != s.slots.end()) {
+        return it->second;
+      }
+    }
+    std::unique_lock lock(s.mutex);
+    if (auto it = s.slots.find(std::cref(std::as_const(value))); it != s.slots.end()) {
+      return it->second;
+    }
+    uint32_t slot = append(std::forward<U>(value));
+    s.slots.emplace(std::cref((*this)[slot]), slot);
+    return slot;
+  }
+
+  const T& operator[](uint32_t slot) const noexcept {
+    auto [k, offset] = locate(slot);
+    return chunks_[k][offset];
+  }
+
+  size_t size() const noexcept {
+    return size_.load(std::memory_order_acquire);
+  }
+
+private:
+  static std::pair<size_t, size_t> locate(size_t slot) noexcept {
+    size_t k = std::bit_width(slot / first_chunk + 1) - 1;
+    return {k, slot - first_chunk * ((size_t(1) << k) - 1)};
+  }
+
+  template <typename U>
+  uint32_t append(U&& value) {
+    T tmp(std::forward<U>(value));
+    std::lock_guard lock(append_mutex_);
+    size_t slot = size_.load(std::memory_order_relaxed);
+    if (slot > UINT32_MAX) {
+      throw std::length_error("variant_pool: too many values of one alternative");
+    }
+    auto [k, offset] = locate(slot);
+    if (chunks_[k] == nullptr) {
+      chunks_[k] = std::allocator<T>().allocate(first_chunk << k);
+    }
+    std::construct_at(chunks_[k] + offset, std::move(tmp));
+    size_.store(slot + 1, std::memory_order_release);
+    return uint32_t(slot);
+  }
+
+  std::array<T*, chunks> chunks_{};
+  std::atomic<size_t> size_{0};
+  std::mutex append_mutex_;
+  std::array<shard, shards> shards_;
+};
+} // namespace details
+
+// Interns variant values: every distinct value of every alternative is stored once, and intern returns the same
+// pool_handle for equal values. Interning is safe from any number of threads; handles stay valid, and dereferencing
+// them needs no lock, for the lifetime of the pool. Values are never removed.
+template <typename... Types>
+class variant_pool {
+  template <typename T>
+  static constexpr bool is_alternative = details::count_of_v<T, Types...> == 1;
+
+public:
+  using handle = pool_handle<Types...>;
+
+  variant_pool() = default;
+
+  variant_pool(const variant_pool&) = delete;
+  variant_pool& operator=(const variant_pool&) = delete;
+
+  // The table hashes and compares values as the alternative type, so anything else is converted to it first.
+  template <size_t Index, typename U, typename T = details::get_type_t<Index, Types...>>
+  handle intern(in_place_index_t<Index>, U&& value) requires(std::is_constructible_v<T, U>) {
+    if constexpr (std::is_same_v<std::remove_cvref_t<U>, T>) {
+      return handle(Index, std::get<Index>(tables_).intern(std::forward<U>(value)));
+    } else {
+      return intern(in_place_index<Index>, T(std::forward<U>(value)));
+    }
+  }
+
+  template <typename T>
+  handle intern(T&& value) requires is_alternative<std::remove_cvref_t<T>> {
+    return intern(in_place_index<details::find_first_v<std::remove_cvref_t<T>, Types...>>, std::forward<T>(value));
+  }
+
+  handle intern(const variant<Types...>& v) {
+    if (v.valueless_by_exception()) {
+      details::throw_bad_variant_access();
+    }
+    return details::visit_by_index([this, &v](auto index) { return intern(in_place_index<index>, ::get<index>(v)); },
+                                   v);
+  }
+
+  template <size_t Index>
+  const details::get_type_t<Index, Types...>& get(handle h) const {
+    if (h.index() != Index) {
+      details::throw_bad_variant_access();
+    }
+    return std::get<Index>(tables_)[h.slot()];
+  }
+
+  template <typename T, size_t Index = details::find_first_v<T, Types...>>
+  const T& get(handle h) const requires is_alternative<T> {
+    return get<Index>(h);
+  }
+
+  // A view of the interned value that get, visit and the variant_cref comparisons accept.
+  variant_cref<Types...> operator[](handle h) const {
+    if (h.valueless_by_exception()) {
+      details::throw_bad_variant_access();
+    }
+    return details::visit_index<sizeof...(Types)>(
+        [this, h](auto index) {
+          return variant_cref<Types...>(in_place_index<index>, std::get<index>(tables_)[h.slot()]);
+        },
+        h.index());
+  }
+
+  template <size_t Index>
+  size_t size() const noexcept {
+    return std::get<Index>(tables_).size();
+  }
+
+  size_t size() const noexcept {
+    return std::apply([](const auto&... tables) { return (tables.size() + ...); }, tables_);
+  }
+
+private:
+  std::tuple<details::intern_table<Types, variant_key_hash>...> tables_;
+};
+
+#endif
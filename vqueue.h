@@ -0,0 +1,274 @@
+#ifndef VARIANT_QUEUE_H
+#define VARIANT_QUEUE_H
+
+#include "variant.h"
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+// Bounded ring queues whose slots hold the variant itself: producers construct the alternative directly in a slot
+// and consumers visit it there before destroying it, so a message is never moved through an intermediate variant.
+
+namespace details {
+inline constexpr size_t queue_cache_line = 64;
+
+inline size_t queue_capacity(size_t capacity) {
+  if (capacity == 0) {
+    throw std::invalid_argument("queue capacity must be positive");
+  }
+  return std::bit_ceil(capacity);
+}
+
+template <typename V>
+struct queue_storage {
+  V* get() noexcept {
+    return std::launder(reinterpret_cast<V*>(bytes));
+  }
+
+  alignas(V) std::byte bytes[sizeof(V)];
+};
+} // namespace details
+
+template <typename... Types>
+class spsc_queue {
+public:
+  using value_type = variant<Types...>;
+
+  explicit spsc_queue(size_t capacity)
+      : mask_(details::queue_capacity(capacity) - 1),
+        slots_(std::make_unique<details::queue_storage<value_type>[]>(mask_ + 1)) {}
+
+  spsc_queue(const spsc_queue&) = delete;
+  spsc_queue& operator=(const spsc_queue&) = delete;
+
+  ~spsc_queue() {
+    for (size_t head = head_.load(std::memory_order_relaxed), tail = tail_.load(std::memory_order_relaxed);
+         head != tail; ++head) {
+      std::destroy_at(slots_[head & mask_].get());
+    }
+  }
+
+  size_t capacity() const noexcept {
+    return mask_ + 1;
+  }
+
+  template <size_t Index, typename... Args>
+  bool try_emplace(Args&&... args) requires(Index < sizeof...(Types)) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_cache_ > mask_) {
+      head_cache_ = head_.load(std::memory_order_acquire);
+      if (tail - head_cache_ > mask_) {
+        return false;
+      }
+    }
+    std::construct_at(slots_[tail & mask_].get(), in_place_index<Index>, std::forward<Args>(args)...);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  template <typename T, typename... Args>
+  bool try_emplace(Args&&... args) requires(details::count_of_v<T, Types...> == 1) {
+    return try_emplace<details::find_first_v<T, Types...>>(std::forward<Args>(args)...);
+  }
+
+  template <size_t Index, typename... Args>
+  void emplace(Args&&... args) requires(Index < sizeof...(Types)) {
+    while (!try_emplace<Index>(std::forward<Args>(args)...)) {
+      std::this_thread::yield();
+    }
+  }
+
+  template <typename T, typename... Args>
+  void emplace(Args&&... args) requires(details::count_of_v<T, Types...> == 1) {
+    emplace<details::find_first_v<T, Types...>>(std::forward<Args>(args)...);
+  }
+
+  template <typename F>
+  bool try_consume(F&& visitor) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_cache_) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+      if (head == tail_cache_) {
+        return false;
+      }
+    }
+    value_type* value = slots_[head & mask_].get();
+    struct release {
+      ~release() {
+        std::destroy_at(value);
+        self->head_.store(head + 1, std::memory_order_release);
+      }
+
+      spsc_queue* self;
+      value_type* value;
+      size_t head;
+    } guard{this, value, head};
+    visit(std::forward<F>(visitor), *value);
+    return true;
+  }
+
+  template <typename F>
+  void consume(F&& visitor) {
+    while (!try_consume(visitor)) {
+      std::this_thread::yield();
+    }
+  }
+
+  bool empty() const noexcept {
+    return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+  }
+
+private:
+  const size_t mask_;
+  std::unique_ptr<details::queue_storage<value_type>[]> slots_;
+  alignas(details::queue_cache_line) std::atomic<size_t> tail_{0};
+  size_t head_cache_ = 0;
+  alignas(details::queue_cache_line) std::atomic<size_t> head_{0};
+  size_t tail_cache_ = 0;
+};
+
+// Bounded multi-producer multi-consumer queue after Dmitry Vyukov's design: each slot carries a sequence number that
+// tells producers and consumers whether it is free for the current lap.
+template <typename... Types>
+class mpmc_queue {
+public:
+  using value_type = variant<Types...>;
+
+  explicit mpmc_queue(size_t capacity)
+      : mask_(details::queue_capacity(capacity) - 1), cells_(std::make_unique<cell[]>(mask_ + 1)) {
+    for (size_t i = 0; i <= mask_; ++i) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  mpmc_queue(const mpmc_queue&) = delete;
+  mpmc_queue& operator=(const mpmc_queue&) = delete;
+
+  ~mpmc_queue() {
+    for (size_t pos = dequeue_.load(std::memory_order_relaxed), end = enqueue_.load(std::memory_order_relaxed);
+         pos != end; ++pos) {
+      cell& c = cells_[pos & mask_];
+      if (c.constructed) {
+        std::destroy_at(c.storage.get());
+      }
+    }
+  }
+
+  size_t capacity() const noexcept {
+    return mask_ + 1;
+  }
+
+  template <size_t Index, typename... Args>
+  bool try_emplace(Args&&... args) requires(Index < sizeof...(Types)) {
+    size_t pos = enqueue_.load(std::memory_order_relaxed);
+    cell* c;
+    while (true) {
+      c = &cells_[pos & mask_];
+      size_t sequence = c->sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(sequence - pos);
+      if (diff == 0) {
+        if (enqueue_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_.load(std::memory_order_relaxed);
+      }
+    }
+    // The slot is claimed, so it has to be published even if the constructor throws; consumers skip such slots.
+    c->constructed = false;
+    struct publish {
+      ~publish() {
+        c->sequence.store(pos + 1, std::memory_order_release);
+      }
+
+      cell* c;
+      size_t pos;
+    } guard{c, pos};
+    std::construct_at(c->storage.get(), in_place_index<Index>, std::forward<Args>(args)...);
+    c->constructed = true;
+    return true;
+  }
+
+  template <typename T, typename... Args>
+  bool try_emplace(Args&&... args) requires(details::count_of_v<T, Types...> == 1) {
+    return try_emplace<details::find_first_v<T, Types...>>(std::forward<Args>(args)...);
+  }
+
+  template <size_t Index, typename... Args>
+  void emplace(Args&&... args) requires(Index < sizeof...(Types)) {
+    while (!try_emplace<Index>(std::forward<Args>(args)...)) {
+      std::this_thread::yield();
+    }
+  }
+
+  template <typename T, typename... Args>
+  void emplace(Args&&... args) requires(details::count_of_v<T, Types...> == 1) {
+    emplace<details::find_first_v<T, Types...>>(std::forward<Args>(args)...);
+  }
+
+  template <typename F>
+  bool try_consume(F&& visitor) {
+    while (true) {
+      size_t pos = dequeue_.load(std::memory_order_relaxed);
+      cell* c;
+      while (true) {
+        c = &cells_[pos & mask_];
+        size_t sequence = c->sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<std::ptrdiff_t>(sequence - (pos + 1));
+        if (diff == 0) {
+          if (dequeue_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+            break;
+          }
+        } else if (diff < 0) {
+          return false;
+        } else {
+          pos = dequeue_.load(std::memory_order_relaxed);
+        }
+      }
+      struct release {
+        ~release() {
+          if (c->constructed) {
+            std::destroy_at(c->storage.get());
+          }
+          c->sequence.store(pos + mask + 1, std::memory_order_release);
+        }
+
+        cell* c;
+        size_t pos;
+        size_t mask;
+      } guard{c, pos, mask_};
+      if (c->constructed) {
+        visit(std::forward<F>(visitor), *c->storage.get());
+        return true;
+      }
+    }
+  }
+
+  template <typename F>
+  void consume(F&& visitor) {
+    while (!try_consume(visitor)) {
+      std::this_thread::yield();
+    }
+  }
+
+private:
+  struct alignas(details::queue_cache_line) cell {
+    std::atomic<size_t> sequence;
+    bool constructed = false;
+    details::queue_storage<value_type> storage;
+  };
+
+  const size_t mask_;
+  std::unique_ptr<cell[]> cells_;
+  alignas(details::queue_cache_line) std::atomic<size_t> enqueue_{0};
+  alignas(details::queue_cache_line) std::atomic<size_t> dequeue_{0};
+};
+
+#endif
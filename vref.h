@@ -0,0 +1,274 @@
+#ifndef VARIANT_REF_H
+#define VARIANT_REF_H
+
+#include "variant.h"
+
+template <typename... Types>
+struct variant_ref;
+
+template <typename... Types>
+struct variant_cref;
+
+namespace details {
+template <bool Const, typename... Types>
+struct basic_variant_ref {
+  using pointer = std::conditional_t<Const, const void*, void*>;
+
+  template <typename T>
+  using qualified_t = std::conditional_t<Const, const T, T>;
+
+  // Every alternative starts at the storage address, so no dispatch on the index is needed.
+  constexpr basic_variant_ref(qualified_t<variant<Types...>>& v) noexcept
+      : ptr_(v.valueless_by_exception() ? nullptr : vstorage<Types...>::data(v)), index_(v.index()) {}
+
+  template <size_t Index>
+  constexpr basic_variant_ref(in_place_index_t<Index>, qualified_t<get_type_t<Index, Types...>>& value) noexcept
+      : ptr_(std::addressof(value)), index_(Index) {}
+
+  constexpr basic_variant_ref(pointer ptr, size_t index) noexcept : ptr_(ptr), index_(index) {}
+
+  constexpr size_t index() const noexcept {
+    return index_;
+  }
+
+  constexpr bool valueless_by_exception() const noexcept {
+    return index_ == variant_npos;
+  }
+
+  pointer data() const noexcept {
+    return ptr_;
+  }
+
+private:
+  pointer ptr_ = nullptr;
+  size_t index_ = variant_npos;
+};
+} // namespace details
+
+template <typename... Types>
+struct variant_ref : details::basic_variant_ref<false, Types...> {
+  using base = details::basic_variant_ref<false, Types...>;
+
+  constexpr variant_ref(variant<Types...>& v) noexcept : base(v) {} // NOLINT(google-explicit-constructor)
+
+  template <typename T, size_t Index = details::find_first_v<T, Types...>>
+  constexpr variant_ref(T& value) noexcept // NOLINT(google-explicit-constructor)
+      requires(details::count_of_v<T, Types...> == 1)
+      : base(in_place_index<Index>, value) {}
+
+  template <size_t Index>
+  constexpr variant_ref(in_place_index_t<Index> in, details::get_type_t<Index, Types...>& value) noexcept
+      : base(in, value) {}
+};
+
+template <typename... Types>
+struct variant_cref : details::basic_variant_ref<true, Types...> {
+  using base = details::basic_variant_ref<true, Types...>;
+
+  constexpr variant_cref(const variant<Types...>& v) noexcept : base(v) {} // NOLINT(google-explicit-constructor)
+
+  // Like std::reference_wrapper, a view of a temporary is rejected instead of dangling.
+  variant_cref(const variant<Types...>&&) = delete;
+
+  constexpr variant_cref(variant_ref<Types...> r) noexcept // NOLINT(google-explicit-constructor)
+      : base(r.data(), r.index()) {}
+
+  template <typename T, size_t Index = details::find_first_v<T, Types...>>
+  constexpr variant_cref(const T& value) noexcept // NOLINT(google-explicit-constructor)
+      requires(details::count_of_v<T, Types...> == 1)
+      : base(in_place_index<Index>, value) {}
+
+  template <typename T>
+  variant_cref(const T&&) requires(details::count_of_v<T, Types...> == 1) = delete;
+
+  template <size_t Index>
+  constexpr variant_cref(in_place_index_t<Index> in, const details::get_type_t<Index, Types...>& value) noexcept
+      : base(in, value) {}
+
+  template <size_t Index>
+  variant_cref(in_place_index_t<Index>, const details::get_type_t<Index, Types...>&&) = delete;
+};
+
+template <typename... Types>
+struct variant_size<variant_ref<Types...>> : details::pack_size<Types...> {};
+
+template <typename... Types>
+struct variant_size<const variant_ref<Types...>> : details::pack_size<Types...> {};
+
+template <typename... Types>
+struct variant_size<variant_cref<Types...>> : details::pack_size<Types...> {};
+
+template <typename... Types>
+struct variant_size<const variant_cref<Types...>> : details::pack_size<Types...> {};
+
+template <size_t Index, typename... Types>
+struct variant_alternative<Index, variant_ref<Types...>> {
+  using type = details::get_type_t<Index, Types...>;
+};
+
+template <size_t Index, typename... Types>
+struct variant_alternative<Index, variant_cref<Types...>> {
+  using type = const details::get_type_t<Index, Types...>;
+};
+
+template <typename T, typename... Types>
+constexpr bool holds_alternative(variant_ref<Types...> r) noexcept requires(details::count_of_v<T, Types...> == 1) {
+  return details::find_first_v<T, Types...> == r.index();
+}
+
+template <typename T, typename... Types>
+constexpr bool holds_alternative(variant_cref<Types...> r) noexcept requires(details::count_of_v<T, Types...> == 1) {
+  return details::find_first_v<T, Types...> == r.index();
+}
+
+template <size_t Index, typename... Types>
+details::get_type_t<Index, Types...>& get(variant_ref<Types...> r) {
+  if (Index == r.index()) {
+    return *static_cast<details::get_type_t<Index, Types...>*>(r.data());
+  }
+  details::throw_bad_variant_access();
+}
+
+template <size_t Index, typename... Types>
+const details::get_type_t<Index, Types...>& get(variant_cref<Types...> r) {
+  if (Index == r.index()) {
+    return *static_cast<const details::get_type_t<Index, Types...>*>(r.data());
+  }
+  details::throw_bad_variant_access();
+}
+
+template <typename T, typename... Types, size_t Index = details::find_first_v<T, Types...>>
+T& get(variant_ref<Types...> r) requires(details::count_of_v<T, Types...> == 1) {
+  return get<Index>(r);
+}
+
+template <typename T, typename... Types, size_t Index = details::find_first_v<T, Types...>>
+const T& get(variant_cref<Types...> r) requires(details::count_of_v<T, Types...> == 1) {
+  return get<Index>(r);
+}
+
+template <size_t Index, typename... Types>
+std::add_pointer_t<details::get_type_t<Index, Types...>> get_if(const variant_ref<Types...>* r) noexcept {
+  return (r != nullptr && Index == r->index()) ? static_cast<details::get_type_t<Index, Types...>*>(r->data())
+                                               : nullptr;
+}
+
+template <size_t Index, typename... Types>
+std::add_pointer_t<const details::get_type_t<Index, Types...>> get_if(const variant_cref<Types...>* r) noexcept {
+  return (r != nullptr && Index == r->index()) ? static_cast<const details::get_type_t<Index, Types...>*>(r->data())
+                                               : nullptr;
+}
+
+template <typename T, typename... Types, size_t Index = details::find_first_v<T, Types...>>
+std::add_pointer_t<T> get_if(const variant_ref<Types...>* r) noexcept {
+  return get_if<Index>(r);
+}
+
+template <typename T, typename... Types, size_t Index = details::find_first_v<T, Types...>>
+std::add_pointer_t<const T> get_if(const variant_cref<Types...>* r) noexcept {
+  return get_if<Index>(r);
+}
+
+template <typename... Types>
+bool operator==(variant_cref<Types...> a, variant_cref<Types...> b) {
+  if (a.index() != b.index()) {
+    return false;
+  }
+  if (a.valueless_by_exception()) {
+    return true;
+  }
+  return details::visit_by_index([&](auto index) { return get<index>(a) == get<index>(b); }, b);
+}
+
+template <typename... Types>
+bool operator!=(variant_cref<Types...> a, variant_cref<Types...> b) {
+  return !(a == b);
+}
+
+template <typename... Types>
+bool operator<(variant_cref<Types...> a, variant_cref<Types...> b) {
+  if (b.valueless_by_exception()) {
+    return false;
+  }
+  if (a.valueless_by_exception()) {
+    return true;
+  }
+  if (a.index() != b.index()) {
+    return a.index() < b.index();
+  }
+  return details::visit_by_index([&](auto index) { return get<index>(a) < get<index>(b); }, b);
+}
+
+template <typename... Types>
+bool operator>(variant_cref<Types...> a, variant_cref<Types...> b) {
+  if (a.valueless_by_exception()) {
+    return false;
+  }
+  if (b.valueless_by_exception()) {
+    return true;
+  }
+  if (a.index() != b.index()) {
+    return a.index() > b.index();
+  }
+  return details::visit_by_index([&](auto index) { return get<index>(a) > get<index>(b); }, b);
+}
+
+template <typename... Types>
+bool operator<=(variant_cref<Types...> a, variant_cref<Types...> b) {
+  if (a.valueless_by_exception()) {
+    return true;
+  }
+  if (b.valueless_by_exception()) {
+    return false;
+  }
+  if (a.index() != b.index()) {
+    return a.index() < b.index();
+  }
+  return details::visit_by_index([&](auto index) { return get<index>(a) <= get<index>(b); }, b);
+}
+
+template <typename... Types>
+bool operator>=(variant_cref<Types...> a, variant_cref<Types...> b) {
+  if (b.valueless_by_exception()) {
+    return true;
+  }
+  if (a.valueless_by_exception()) {
+    return false;
+  }
+  if (a.index() != b.index()) {
+    return a.index() > b.index();
+  }
+  return details::visit_by_index([&](auto index) { return get<index>(a) >= get<index>(b); }, b);
+}
+
+template <typename... Types>
+bool operator==(variant_ref<Types...> a, variant_ref<Types...> b) {
+  return variant_cref<Types...>(a) == variant_cref<Types...>(b);
+}
+
+template <typename... Types>
+bool operator!=(variant_ref<Types...> a, variant_ref<Types...> b) {
+  return variant_cref<Types...>(a) != variant_cref<Types...>(b);
+}
+
+template <typename... Types>
+bool operator<(variant_ref<Types...> a, variant_ref<Types...> b) {
+  return variant_cref<Types...>(a) < variant_cref<Types...>(b);
+}
+
+template <typename... Types>
+bool operator>(variant_ref<Types...> a, variant_ref<Types...> b) {
+  return variant_cref<Types...>(a) > variant_cref<Types...>(b);
+}
+
+template <typename... Types>
+bool operator<=(variant_ref<Types...> a, variant_ref<Types...> b) {
+  return variant_cref<Types...>(a) <= variant_cref<Types...>(b);
+}
+
+template <typename... Types>
+bool operator>=(variant_ref<Types...> a, variant_ref<Types...> b) {
+  return variant_cref<Types...>(a) >= variant_cref<Types...>(b);
+}
+
+#endif
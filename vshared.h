@@ -0,0 +1,275 @@
+#ifndef VARIANT_SHARED_H
+#define VARIANT_SHARED_H
+
+#include "variant.h"
+#include <atomic>
+#include <utility>
+
+// A variant kept out of line in a reference-counted node, for large payloads that are copied far more often than they
+// are changed. Copies share the node; mutable access (non-const get, get_if, visit, emplace, mutate) first gives this
+// object its own node if the current one is shared. Read through a const shared_variant to leave the node shared.
+//
+// The count is atomic, so copies may be made and dropped on different threads; the payload itself is not synchronized.
+// A moved-from shared_variant has no node and is valueless.
+template <typename... Types>
+class shared_variant {
+public:
+  using variant_type = variant<Types...>;
+
+  shared_variant() requires std::is_default_constructible_v<variant_type> : node_(new node()) {}
+
+  shared_variant(const variant_type& v) : node_(new node(v)) {} // NOLINT(google-explicit-constructor)
+
+  shared_variant(variant_type&& v) : node_(new node(std::move(v))) {} // NOLINT(google-explicit-constructor)
+
+  template <typename From>
+  shared_variant(From&& f) // NOLINT(google-explicit-constructor)
+      requires(!std::is_same_v<std::remove_cvref_t<From>, shared_variant> &&
+               !std::is_same_v<std::remove_cvref_t<From>, variant_type> &&
+               std::is_constructible_v<variant_type, From>)
+      : node_(new node(std::forward<From>(f))) {}
+
+  template <typename T, typename... Args>
+  explicit shared_variant(in_place_type_t<T> in, Args&&... args) requires(
+      std::is_constructible_v<variant_type, in_place_type_t<T>, Args...>)
+      : node_(new node(in, std::forward<Args>(args)...)) {}
+
+  template <size_t Index, typename... Args>
+  explicit shared_variant(in_place_index_t<Index> in, Args&&... args) requires(
+      std::is_constructible_v<variant_type, in_place_index_t<Index>, Args...>)
+      : node_(new node(in, std::forward<Args>(args)...)) {}
+
+  shared_variant(const shared_variant& other) noexcept : node_(other.node_) {
+    if (node_ != nullptr) {
+      node_->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  shared_variant(shared_variant&& other) noexcept : node_(std::exchange(other.node_, nullptr)) {}
+
+  shared_variant& operator=(const shared_variant& other) noexcept {
+    shared_variant(other).swap(*this);
+    return *this;
+  }
+
+  shared_variant& operator=(shared_variant&& other) noexcept {
+    shared_variant(std::move(other)).swap(*this);
+    return *this;
+  }
+
+  ~shared_variant() {
+    release();
+  }
+
+  void swap(shared_variant& other) noexcept {
+    std::swap(node_, other.node_);
+  }
+
+  friend void swap(shared_variant& a, shared_variant& b) noexcept {
+    a.swap(b);
+  }
+
+  size_t index() const noexcept {
+    return node_ != nullptr ? node_->value.index() : variant_npos;
+  }
+
+  bool valueless_by_exception() const noexcept {
+    return index() == variant_npos;
+  }
+
+  size_t use_count() const noexcept {
+    return node_ != nullptr ? node_->refs.load(std::memory_order_relaxed) : 0;
+  }
+
+  bool shares_storage_with(const shared_variant& other) const noexcept {
+    return node_ != nullptr && node_ == other.node_;
+  }
+
+  const variant_type& operator*() const {
+    if (node_ == nullptr) {
+      details::throw_bad_variant_access();
+    }
+    return node_->value;
+  }
+
+  const variant_type* operator->() const {
+    return std::addressof(**this);
+  }
+
+  // The only way to the payload for writing: copies it into a node of its own first if the node is shared.
+  variant_type& mutate() {
+    if (node_ == nullptr) {
+      details::throw_bad_variant_access();
+    }
+    if (node_->refs.load(std::memory_order_acquire) != 1) {
+      shared_variant(node_->value).swap(*this);
+    }
+    return node_->value;
+  }
+
+  // Replaces a shared node instead of copying the old payload into a new one only to overwrite it.
+  template <size_t Index, typename... Args>
+  variant_alternative_t<Index, variant_type>& emplace(Args&&... args) requires(
+      std::is_constructible_v<variant_alternative_t<Index, variant_type>, Args...>) {
+    if (node_ == nullptr || node_->refs.load(std::memory_order_acquire) != 1) {
+      shared_variant(in_place_index<Index>, std::forward<Args>(args)...).swap(*this);
+      return get<Index>(node_->value);
+    }
+    return node_->value.template emplace<Index>(std::forward<Args>(args)...);
+  }
+
+  template <typename T, typename... Args, size_t Index = details::find_first_v<T, Types...>>
+  T& emplace(Args&&... args) requires(details::count_of_v<T, Types...> == 1 && std::is_constructible_v<T, Args...>) {
+    return emplace<Index>(std::forward<Args>(args)...);
+  }
+
+private:
+  struct node {
+    template <typename... Args>
+    explicit node(Args&&... args) : value(std::forward<Args>(args)...) {}
+
+    std::atomic<size_t> refs{1};
+    variant_type value;
+  };
+
+  void release() noexcept {
+    if (node_ != nullptr && node_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete node_;
+    }
+  }
+
+  node* node_ = nullptr;
+};
+
+template <typename... Types>
+struct variant_size<shared_variant<Types...>> : details::pack_size<Types...> {};
+
+template <typename... Types>
+struct variant_size<const shared_variant<Types...>> : details::pack_size<Types...> {};
+
+template <size_t Index, typename... Types>
+struct variant_alternative<Index, shared_variant<Types...>> {
+  using type = details::get_type_t<Index, Types...>;
+};
+
+template <size_t Index, typename... Types>
+struct variant_alternative<Index, const shared_variant<Types...>> {
+  using type = const details::get_type_t<Index, Types...>;
+};
+
+template <typename T, typename... Types>
+bool holds_alternative(const shared_variant<Types...>& v) noexcept requires(details::count_of_v<T, Types...> == 1) {
+  return details::find_first_v<T, Types...> == v.index();
+}
+
+template <size_t Index, typename... Types>
+const details::get_type_t<Index, Types...>& get(const shared_variant<Types...>& v) {
+  if (Index != v.index()) {
+    details::throw_bad_variant_access();
+  }
+  return get<Index>(*v);
+}
+
+template <size_t Index, typename... Types>
+details::get_type_t<Index, Types...>& get(shared_variant<Types...>& v) {
+  if (Index != v.index()) {
+    details::throw_bad_variant_access();
+  }
+  return get<Index>(v.mutate());
+}
+
+template <size_t Index, typename... Types>
+details::get_type_t<Index, Types...>&& get(shared_variant<Types...>&& v) {
+  return std::move(get<Index>(v));
+}
+
+template <size_t Index, typename... Types>
+const details::get_type_t<Index, Types...>&& get(const shared_variant<Types...>&& v) {
+  return std::move(get<Index>(v));
+}
+
+template <typename T, typename... Types, size_t Index = details::find_first_v<T, Types...>>
+const T& get(const shared_variant<Types...>& v) requires(details::count_of_v<T, Types...> == 1) {
+  return get<Index>(v);
+}
+
+template <typename T, typename... Types, size_t Index = details::find_first_v<T, Types...>>
+T& get(shared_variant<Types...>& v) requires(details::count_of_v<T, Types...> == 1) {
+  return get<Index>(v);
+}
+
+template <typename T, typename... Types, size_t Index = details::find_first_v<T, Types...>>
+T&& get(shared_variant<Types...>&& v) requires(details::count_of_v<T, Types...> == 1) {
+  return get<Index>(std::move(v));
+}
+
+template <typename T, typename... Types, size_t Index = details::find_first_v<T, Types...>>
+const T&& get(const shared_variant<Types...>&& v) requires(details::count_of_v<T, Types...> == 1) {
+  return get<Index>(std::move(v));
+}
+
+template <size_t Index, typename... Types>
+std::add_pointer_t<const details::get_type_t<Index, Types...>> get_if(const shared_variant<Types...>* v) noexcept {
+  return (v != nullptr && Index == v->index()) ? std::addressof(get<Index>(*v)) : nullptr;
+}
+
+template <size_t Index, typename... Types>
+std::add_pointer_t<details::get_type_t<Index, Types...>> get_if(shared_variant<Types...>* v) {
+  return (v != nullptr && Index == v->index()) ? std::addressof(get<Index>(*v)) : nullptr;
+}
+
+template <typename T, typename... Types, size_t Index = details::find_first_v<T, Types...>>
+std::add_pointer_t<const T> get_if(const shared_variant<Types...>* v) noexcept {
+  return get_if<Index>(v);
+}
+
+template <typename T, typename... Types, size_t Index = details::find_first_v<T, Types...>>
+std::add_pointer_t<T> get_if(shared_variant<Types...>* v) {
+  return get_if<Index>(v);
+}
+
+// Comparisons look at the payloads even when both sides share a node, so that they agree with variant for values
+// that are not equal to themselves.
+template <typename... Types>
+bool operator==(const shared_variant<Types...>& a, const shared_variant<Types...>& b) {
+  return a.valueless_by_exception() || b.valueless_by_exception() ? a.index() == b.index() : *a == *b;
+}
+
+template <typename... Types>
+bool operator!=(const shared_variant<Types...>& a, const shared_variant<Types...>& b) {
+  return !(a == b);
+}
+
+template <typename... Types>
+bool operator<(const shared_variant<Types...>& a, const shared_variant<Types...>& b) {
+  if (b.valueless_by_exception()) {
+    return false;
+  }
+  return a.valueless_by_exception() || *a < *b;
+}
+
+template <typename... Types>
+bool operator>(const shared_variant<Types...>& a, const shared_variant<Types...>& b) {
+  if (a.valueless_by_exception()) {
+    return false;
+  }
+  return b.valueless_by_exception() || *a > *b;
+}
+
+template <typename... Types>
+bool operator<=(const shared_variant<Types...>& a, const shared_variant<Types...>& b) {
+  if (a.valueless_by_exception()) {
+    return true;
+  }
+  return !b.valueless_by_exception() && *a <= *b;
+}
+
+template <typename... Types>
+bool operator>=(const shared_variant<Types...>& a, const shared_variant<Types...>& b) {
+  if (b.valueless_by_exception()) {
+    return true;
+  }
+  return !a.valueless_by_exception() && *a >= *b;
+}
+
+#endif
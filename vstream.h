@@ -0,0 +1,238 @@
+#ifndef VARIANT_STREAM_H
+#define VARIANT_STREAM_H
+
+#include "variant.h"
+#include "vcodec.h"
+#include "vcoro.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// Record encoding: little-endian tag of 1, 2 or 4 bytes (depending on the number of alternatives) followed by
+// the payload. Trivially copyable alternatives are stored as their object representation, the rest as a LEB128
+// length and the bytes produced by variant_codec<T>.
+
+class stream_error : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+namespace details {
+constexpr uint32_t stream_tag_width(size_t alternatives) noexcept {
+  return alternatives <= UINT8_MAX ? 1 : (alternatives <= UINT16_MAX ? 2 : 4);
+}
+} // namespace details
+
+template <typename... Types>
+void variant_encode(const variant<Types...>& v, std::string& out) {
+  static_assert((details::codec_storable<Types> && ...),
+                "every alternative must be trivially copyable or have a variant_codec specialization");
+  if (v.valueless_by_exception()) {
+    details::throw_bad_variant_access("valueless variant can not be encoded");
+  }
+  size_t tag = v.index();
+  for (uint32_t i = 0; i < details::stream_tag_width(sizeof...(Types)); ++i) {
+    out.push_back(static_cast<char>((tag >> (8 * i)) & 0xFF));
+  }
+  details::visit_by_index(
+      [&v, &out](auto index) {
+        using T = details::get_type_t<index, Types...>;
+        const T& value = get<index>(v);
+        if constexpr (details::codec_raw<T>) {
+          out.append(reinterpret_cast<const char*>(std::addressof(value)), sizeof(T));
+        } else {
+          std::string payload;
+          variant_codec<T>::encode(value, payload);
+          uint64_t length = payload.size();
+          do {
+            auto byte = static_cast<uint8_t>(length & 0x7F);
+            length >>= 7;
+            out.push_back(static_cast<char>(length != 0 ? (byte | 0x80) : byte));
+          } while (length != 0);
+          out.append(payload);
+        }
+      },
+      v);
+}
+
+template <typename... Types>
+struct stream_decoder {
+  static_assert((details::codec_storable<Types> && ...),
+                "every alternative must be trivially copyable or have a variant_codec specialization");
+
+  static constexpr size_t default_max_record_size = size_t(64) << 20;
+
+  explicit stream_decoder(size_t max_record_size = default_max_record_size) noexcept
+      : max_record_size_(max_record_size) {}
+
+  // Hands the decoder the next chunk, which it reads without copying and which must stay alive until next() returns
+  // false. The previous chunk has to be drained by then: feeding while unread input remains throws stream_error
+  // instead of dropping those bytes.
+  void feed(std::string_view chunk) {
+    if (!input_.empty()) {
+      throw stream_error("previous chunk has not been consumed");
+    }
+    input_ = chunk;
+  }
+
+  template <typename F>
+  bool next(F&& visitor) {
+    while (!input_.empty() || (state_ == state::payload && need_ == buffer_.size())) {
+      switch (state_) {
+      case state::tag:
+        read_tag();
+        break;
+      case state::length:
+        read_length();
+        break;
+      case state::payload:
+        if (buffer_.empty() && input_.size() >= need_) {
+          std::string_view payload = input_.substr(0, need_);
+          input_.remove_prefix(need_);
+          state_ = state::tag;
+          emit(payload, visitor);
+          return true;
+        }
+        size_t take = std::min(need_ - buffer_.size(), input_.size());
+        buffer_.append(input_.substr(0, take));
+        input_.remove_prefix(take);
+        if (buffer_.size() == need_) {
+          state_ = state::tag;
+          std::string payload;
+          payload.swap(buffer_);
+          emit(payload, visitor);
+          payload.clear();
+          buffer_.swap(payload);
+          return true;
+        }
+        break;
+      }
+    }
+    return false;
+  }
+
+  template <typename F>
+  size_t feed(std::string_view chunk, F&& visitor) {
+    feed(chunk);
+    size_t decoded = 0;
+    while (next(visitor)) {
+      ++decoded;
+    }
+    return decoded;
+  }
+
+  bool idle() const noexcept {
+    return state_ == state::tag && tag_bytes_ == 0;
+  }
+
+  void finish() const {
+    if (!idle()) {
+      throw stream_error("stream ended inside a record");
+    }
+  }
+
+  size_t buffered() const noexcept {
+    return buffer_.size();
+  }
+
+private:
+  enum class state { tag, length, payload };
+
+  static constexpr uint32_t tag_width = details::stream_tag_width(sizeof...(Types));
+
+  static constexpr size_t raw_sizes[] = {(details::codec_raw<Types> ? sizeof(Types) : 0)...};
+
+  void read_tag() {
+    while (tag_bytes_ < tag_width && !input_.empty()) {
+      tag_ |= size_t(static_cast<uint8_t>(input_.front())) << (8 * tag_bytes_++);
+      input_.remove_prefix(1);
+    }
+    if (tag_bytes_ < tag_width) {
+      return;
+    }
+    if (tag_ >= sizeof...(Types)) {
+      throw stream_error("unknown alternative tag in stream");
+    }
+    if (raw_sizes[tag_] != 0) {
+      start_payload(raw_sizes[tag_]);
+    } else {
+      need_ = 0;
+      length_shift_ = 0;
+      state_ = state::length;
+    }
+  }
+
+  void read_length() {
+    while (!input_.empty()) {
+      auto byte = static_cast<uint8_t>(input_.front());
+      input_.remove_prefix(1);
+      if (length_shift_ >= 64) {
+        throw stream_error("record length is too long");
+      }
+      need_ |= size_t(byte & 0x7F) << length_shift_;
+      length_shift_ += 7;
+      if ((byte & 0x80) == 0) {
+        start_payload(need_);
+        return;
+      }
+    }
+  }
+
+  void start_payload(size_t size) {
+    if (size > max_record_size_) {
+      throw stream_error("record exceeds the decoder buffer limit");
+    }
+    need_ = size;
+    state_ = state::payload;
+  }
+
+  template <typename F>
+  void emit(std::string_view payload, F& visitor) {
+    size_t tag = std::exchange(tag_, 0);
+    tag_bytes_ = 0;
+    details::visit_index<sizeof...(Types)>(
+        [&payload, &visitor](auto index) {
+          using T = details::get_type_t<index, Types...>;
+          if constexpr (details::codec_raw<T>) {
+            T value;
+            std::memcpy(std::addressof(value), payload.data(), sizeof(T));
+            std::invoke(visitor, index, std::move(value));
+          } else {
+            std::invoke(visitor, index, variant_codec<T>::decode(payload));
+          }
+        },
+        tag);
+  }
+
+  std::string_view input_;
+  std::string buffer_;
+  size_t max_record_size_;
+  size_t tag_ = 0;
+  uint32_t tag_bytes_ = 0;
+  uint32_t length_shift_ = 0;
+  size_t need_ = 0;
+  state state_ = state::tag;
+};
+
+template <typename... Types, typename Chunks>
+generator<variant<Types...>> decode_stream(Chunks chunks,
+                                           size_t max_record_size = stream_decoder<Types...>::default_max_record_size) {
+  stream_decoder<Types...> decoder(max_record_size);
+  std::optional<variant<Types...>> current;
+  for (auto&& chunk : chunks) {
+    decoder.feed(std::string_view(chunk));
+    while (decoder.next([&current](auto index, auto&& value) {
+      current.emplace(in_place_index<index>, std::forward<decltype(value)>(value));
+    })) {
+      co_yield *current;
+    }
+  }
+  decoder.finish();
+}
+
+#endif
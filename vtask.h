@@ -0,0 +1,438 @@
+#ifndef VARIANT_TASK_H
+#define VARIANT_TASK_H
+
+#include "variant.h"
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <new>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Stands in for the result of an operation that produces nothing, so that it still has an alternative in when_any.
+struct void_result {};
+
+namespace details {
+// Coroutine frames are recycled through per-thread free lists of 64-byte size classes, so that a steady stream of
+// tasks of the same shape does not touch the allocator after the first few. Each list keeps at most max_cached
+// frames, and the cached frames go back to the allocator when the thread exits.
+class frame_pool {
+public:
+  static constexpr size_t max_cached = 64;
+
+  static void* allocate(size_t size) {
+    size_t cls = size_class(size);
+    if (cls < classes) {
+      free_list& list = cache().lists[cls];
+      if (list.head != nullptr) {
+        --list.size;
+        return std::exchange(list.head, list.head->next);
+      }
+      return ::operator new((cls + 1) * granularity);
+    }
+    return ::operator new(size);
+  }
+
+  static void deallocate(void* ptr, size_t size) noexcept {
+    size_t cls = size_class(size);
+    if (cls < classes) {
+      thread_cache& c = cache();
+      free_list& list = c.lists[cls];
+      if (c.alive && list.size < max_cached) {
+        list.head = ::new (ptr) node{list.head};
+        ++list.size;
+        return;
+      }
+    }
+    ::operator delete(ptr);
+  }
+
+private:
+  static constexpr size_t granularity = 64;
+  static constexpr size_t classes = 16;
+
+  struct node {
+    node* next;
+  };
+
+  struct free_list {
+    node* head = nullptr;
+    size_t size = 0;
+  };
+
+  // Frames freed by thread_local objects destroyed after this one bypass the cache.
+  struct thread_cache {
+    ~thread_cache() {
+      alive = false;
+      for (free_list& list : lists) {
+        while (list.head != nullptr) {
+          ::operator delete(std::exchange(list.head, list.head->next));
+        }
+        list.size = 0;
+      }
+    }
+
+    std::array<free_list, classes> lists{};
+    bool alive = true;
+  };
+
+  static constexpr size_t size_class(size_t size) noexcept {
+    return (size - 1) / granularity;
+  }
+
+  static thread_cache& cache() noexcept {
+    thread_local thread_cache c;
+    return c;
+  }
+};
+
+struct pooled_frame {
+  static void* operator new(size_t size) {
+    return frame_pool::allocate(size);
+  }
+
+  static void operator delete(void* ptr, size_t size) noexcept {
+    frame_pool::deallocate(ptr, size);
+  }
+};
+
+struct task_pending {};
+
+template <typename T>
+using task_value_t = std::conditional_t<std::is_void_v<T>, void_result, T>;
+
+template <typename T>
+struct task_promise_base : pooled_frame {
+  template <typename U>
+  void return_value(U&& value) {
+    result.template emplace<1>(std::forward<U>(value));
+  }
+
+  variant<task_pending, T, std::exception_ptr> result;
+};
+
+template <>
+struct task_promise_base<void> : pooled_frame {
+  void return_void() noexcept {
+    result.emplace<1>();
+  }
+
+  variant<task_pending, void_result, std::exception_ptr> result;
+};
+} // namespace details
+
+class event_loop;
+
+// A lazily started coroutine whose result or exception is kept in a variant until it is awaited. Awaiting a task
+// starts it and resumes the awaiting coroutine from its final suspend point without going through a scheduler.
+template <typename T = void>
+class task {
+public:
+  struct promise_type : details::task_promise_base<T> {
+    task get_return_object() noexcept {
+      return task(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+
+    std::suspend_always initial_suspend() const noexcept {
+      return {};
+    }
+
+    auto final_suspend() const noexcept {
+      struct final_awaiter {
+        bool await_ready() const noexcept {
+          return false;
+        }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) const noexcept {
+          return handle.promise().continuation;
+        }
+
+        void await_resume() const noexcept {}
+      };
+      return final_awaiter{};
+    }
+
+    void unhandled_exception() noexcept {
+      this->result.template emplace<2>(std::current_exception());
+    }
+
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+  };
+
+  task(task&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+
+  task& operator=(task&& other) noexcept {
+    if (this != &other) {
+      destroy();
+      handle_ = std::exchange(other.handle_, nullptr);
+    }
+    return *this;
+  }
+
+  ~task() {
+    destroy();
+  }
+
+  bool await_ready() const noexcept {
+    return handle_.done();
+  }
+
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept {
+    handle_.promise().continuation = continuation;
+    return handle_;
+  }
+
+  T await_resume() {
+    auto& result = handle_.promise().result;
+    if (result.index() == 2) {
+      std::rethrow_exception(get<2>(result));
+    }
+    if constexpr (!std::is_void_v<T>) {
+      return std::move(get<1>(result));
+    }
+  }
+
+private:
+  friend class event_loop;
+
+  explicit task(std::coroutine_handle<promise_type> handle) noexcept : handle_(handle) {}
+
+  void destroy() noexcept {
+    if (handle_) {
+      handle_.destroy();
+    }
+  }
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+// A single-threaded run queue. Coroutines that co_await schedule() are resumed in FIFO order by run(); the queue
+// keeps its capacity between batches, so posting does not allocate once it has grown to the working set.
+class event_loop {
+public:
+  auto schedule() noexcept {
+    struct awaiter {
+      bool await_ready() const noexcept {
+        return false;
+      }
+
+      void await_suspend(std::coroutine_handle<> handle) const {
+        loop.post(handle);
+      }
+
+      void await_resume() const noexcept {}
+
+      event_loop& loop;
+    };
+    return awaiter{*this};
+  }
+
+  void post(std::coroutine_handle<> handle) {
+    ready_.push_back(handle);
+  }
+
+  // Resumes queued coroutines, including the ones they post, until the queue is empty.
+  void run() {
+    while (!ready_.empty()) {
+      std::swap(ready_, running_);
+      for (auto handle : running_) {
+        handle.resume();
+      }
+      running_.clear();
+    }
+  }
+
+  template <typename T>
+  T run(task<T> t) {
+    post(t.handle_);
+    run();
+    return t.await_resume();
+  }
+
+private:
+  std::vector<std::coroutine_handle<>> ready_;
+  std::vector<std::coroutine_handle<>> running_;
+};
+
+namespace details {
+template <typename Awaitable>
+using await_result_t = task_value_t<decltype(std::declval<Awaitable&&>().await_resume())>;
+
+template <typename... Results>
+struct race_state {
+  template <size_t Index, typename U>
+  void settle(U&& value) {
+    result.emplace(in_place_index<Index>, std::forward<U>(value));
+    detach_others(Index);
+  }
+
+  void fail(size_t index, std::exception_ptr error) noexcept {
+    exception = std::move(error);
+    detach_others(index);
+  }
+
+  void detach_others(size_t winner) noexcept {
+    for (size_t i = 0; i < sizeof...(Results); ++i) {
+      if (i != winner && links[i] != nullptr) {
+        *links[i] = nullptr;
+        links[i] = nullptr;
+      }
+    }
+    settled = true;
+  }
+
+  std::optional<variant<Results...>> result;
+  std::exception_ptr exception;
+  std::coroutine_handle<> continuation;
+  // Each running entrant's pointer back to this state; the winner clears the others so that they finish on their own.
+  std::array<race_state**, sizeof...(Results)> links{};
+  bool settled = false;
+  bool starting = true;
+};
+
+// A detached coroutine that awaits one operand of when_any and reports to the race while it is still attached.
+template <size_t Index, typename State>
+struct race_entrant {
+  struct promise_type : pooled_frame {
+    template <typename Awaitable>
+    promise_type(State* s, Awaitable&) noexcept : state(s) {
+      state->links[Index] = &state;
+    }
+
+    race_entrant get_return_object() noexcept {
+      return race_entrant(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+
+    std::suspend_always initial_suspend() const noexcept {
+      return {};
+    }
+
+    auto final_suspend() const noexcept {
+      struct final_awaiter {
+        bool await_ready() const noexcept {
+          return false;
+        }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) const noexcept {
+          std::coroutine_handle<> next = std::noop_coroutine();
+          if (State* s = handle.promise().state) {
+            s->links[Index] = nullptr;
+            if (!s->starting) {
+              next = s->continuation;
+            }
+          }
+          handle.destroy();
+          return next;
+        }
+
+        void await_resume() const noexcept {}
+      };
+      return final_awaiter{};
+    }
+
+    template <typename U>
+    void return_value(U&& value) {
+      if (state != nullptr) {
+        state->template settle<Index>(std::forward<U>(value));
+      }
+    }
+
+    void unhandled_exception() noexcept {
+      if (state != nullptr) {
+        state->fail(Index, std::current_exception());
+      }
+    }
+
+    State* state;
+  };
+
+  race_entrant(race_entrant&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+  ~race_entrant() {
+    if (handle) {
+      handle.promise().state->links[Index] = nullptr;
+      handle.destroy();
+    }
+  }
+
+  // Runs the entrant until its first suspension; from then on it owns itself.
+  void start() {
+    std::exchange(handle, nullptr).resume();
+  }
+
+  explicit race_entrant(std::coroutine_handle<promise_type> h) noexcept : handle(h) {}
+
+  std::coroutine_handle<promise_type> handle;
+};
+
+template <size_t Index, typename State, typename Awaitable>
+race_entrant<Index, State> enter_race(State*, Awaitable operand) {
+  if constexpr (std::is_void_v<decltype(std::move(operand).await_resume())>) {
+    co_await std::move(operand);
+    co_return void_result{};
+  } else {
+    co_return co_await std::move(operand);
+  }
+}
+
+template <typename... Awaitables>
+class when_any_awaiter {
+public:
+  using result_type = variant<await_result_t<Awaitables>...>;
+
+  explicit when_any_awaiter(Awaitables&&... operands) : operands_(std::move(operands)...) {}
+
+  bool await_ready() const noexcept {
+    return false;
+  }
+
+  // Entrants are started in order and the rest are dropped unstarted once one of them finishes synchronously, in
+  // which case the awaiting coroutine continues without suspending.
+  // If starting an entrant throws (its frame cannot be allocated, or its operand cannot be moved), the ones already
+  // running are detached before the exception destroys state_, so they finish on their own like losers do.
+  bool await_suspend(std::coroutine_handle<> continuation) {
+    state_.continuation = continuation;
+    try {
+      start(std::index_sequence_for<Awaitables...>());
+    } catch (...) {
+      state_.detach_others(variant_npos);
+      throw;
+    }
+    state_.starting = false;
+    return !state_.settled;
+  }
+
+  result_type await_resume() {
+    if (state_.exception) {
+      std::rethrow_exception(state_.exception);
+    }
+    return std::move(*state_.result);
+  }
+
+private:
+  using state_type = race_state<await_result_t<Awaitables>...>;
+
+  template <size_t... Indexes>
+  void start(std::index_sequence<Indexes...>) {
+    ((state_.settled ? void() : enter_race<Indexes>(&state_, std::move(std::get<Indexes>(operands_))).start()), ...);
+  }
+
+  std::tuple<Awaitables...> operands_;
+  state_type state_;
+};
+} // namespace details
+
+// Awaits the operands concurrently and yields a variant holding the result of the first one to complete, emplaced at
+// that operand's index; an exception from the first one is rethrown instead. The others are not cancelled: they run
+// to completion on whatever resumes them, and their results are discarded.
+template <typename... Awaitables>
+auto when_any(Awaitables... operands) {
+  static_assert(sizeof...(Awaitables) > 0, "when_any needs at least one operand");
+  return details::when_any_awaiter<Awaitables...>(std::move(operands)...);
+}
+
+#endif
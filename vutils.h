@@ -4,17 +4,23 @@
 #include "vdefines.h"
 #include <array>
 #include <cstddef>
+#include <cstdlib>
 #include <exception>
 #include <functional>
+#include <new>
 #include <type_traits>
 
+VARIANT_BEGIN_EXPORT
 template <typename... Types>
 struct variant;
 
 namespace details {
 template <typename... Types>
 struct vstorage;
-}
+
+template <size_t N>
+struct index_holder;
+} // namespace details
 class bad_variant_access : std::exception {
   const char* message = "bad variant access";
 
@@ -28,6 +34,21 @@ public:
   }
 };
 
+namespace details {
+// Kept out of line so the failure path does not weigh on inlining of get and visit.
+[[noreturn]] VARIANT_COLD inline void throw_bad_variant_access(const char* what = "bad variant access") {
+#if defined(VARIANT_ACCESS_FAILURE_HANDLER)
+  VARIANT_ACCESS_FAILURE_HANDLER(what);
+  std::abort();
+#elif defined(VARIANT_NO_EXCEPTIONS)
+  static_cast<void>(what);
+  std::abort();
+#else
+  throw bad_variant_access(what);
+#endif
+}
+} // namespace details
+
 namespace details {
 template <size_t Index, typename... Types>
 struct get_type;
@@ -53,6 +74,11 @@ using get_type_t = typename get_type<Index, Types...>::type;
 template <typename... Types>
 struct pack_size : std::integral_constant<size_t, sizeof...(Types)> {};
 
+// The factory's prvalue result initializes T directly at the placement site, so T may be neither copyable nor movable.
+template <typename F, typename T>
+concept is_factory_for =
+    std::is_invocable_v<F> && requires(F&& f, void* p) { ::new (p) T(std::invoke(std::forward<F>(f))); };
+
 } // namespace details
 
 template <typename Variant>
@@ -73,6 +99,9 @@ struct variant_size<variant<Types...>> : details::pack_size<Types...> {};
 template <typename... Types>
 struct variant_size<details::vstorage<Types...>> : details::pack_size<Types...> {};
 
+template <size_t N>
+struct variant_size<details::index_holder<N>> : std::integral_constant<size_t, N> {};
+
 template <typename Variant>
 inline constexpr size_t variant_size_v = variant_size<Variant>::value;
 
@@ -128,6 +157,21 @@ struct best_construct_type<T, Index, Var, Types...> : best_construct_type<T, Ind
 template <typename T, typename... Types>
 using chosen_construct_type = decltype(best_construct_type<T, 0, Types...>::choose(std::declval<T>()));
 
+template <typename T>
+inline constexpr bool is_variant_v = false;
+
+template <typename... Types>
+inline constexpr bool is_variant_v<variant<Types...>> = true;
+
+// A value compares against the alternative the converting constructor would pick for it.
+template <typename T, typename... Types>
+concept compares_as_alternative = (!is_variant_v<std::remove_cvref_t<T>>)&&requires {
+  typename chosen_construct_type<const T&, Types...>;
+};
+
+template <typename T, typename... Types>
+inline constexpr size_t compared_index_v = chosen_construct_type<const T&, Types...>::index;
+
 template <typename T, typename... Types>
 struct count_of;
 
@@ -183,7 +227,7 @@ constexpr variant_alternative_t<Index, variant<Types...>>& get(variant<Types...>
   if (Index == v.index()) {
     return v.storage.get(in_place_index<Index>);
   }
-  throw bad_variant_access{};
+  details::throw_bad_variant_access();
 }
 
 template <size_t Index, typename... Types>
@@ -191,7 +235,7 @@ constexpr const variant_alternative_t<Index, variant<Types...>>& get(variant<Typ
   if (Index == v.index()) {
     return v.storage.get(in_place_index<Index>);
   }
-  throw bad_variant_access{};
+  details::throw_bad_variant_access();
 }
 
 template <size_t Index, typename... Types>
@@ -209,7 +253,7 @@ constexpr T& get(variant<Types...>& v) {
   if (holds_alternative<T>(v)) {
     return v.storage.get(in_place_index<Index>);
   }
-  throw bad_variant_access{};
+  details::throw_bad_variant_access();
 }
 
 template <typename T, typename... Types, size_t Index = details::find_first_v<T, Types...>>
@@ -217,7 +261,7 @@ constexpr const T& get(variant<Types...> const& v) {
   if (holds_alternative<T>(v)) {
     return v.storage.get(in_place_index<Index>);
   }
-  throw bad_variant_access{};
+  details::throw_bad_variant_access();
 }
 
 template <typename T, typename... Types, size_t Index = details::find_first_v<T, Types...>>
@@ -312,15 +356,98 @@ constexpr decltype(auto) visit_by_index(T&& visitor, Types&&... vars) {
 
 template <typename T, typename... Types>
 inline constexpr auto matrix_v = create_matrix<T, Types...>();
+
+template <size_t N>
+struct index_holder {
+  size_t index_;
+
+  constexpr size_t index() const noexcept {
+    return index_;
+  }
+};
+
+template <size_t N, typename T>
+constexpr decltype(auto) visit_index(T&& visitor, size_t index) {
+  return visit_by_index(std::forward<T>(visitor), index_holder<N>{index});
+}
+
+// Dispatches one variant per level: every level is a table of variant_size entries that binds the next index and
+// jumps to the table of the following level. Subtrees that contain no combination the visitor accepts as R collapse
+// into a single reject entry and are never instantiated.
+template <typename R, typename T, typename... Types>
+struct sparse_visit {
+  template <size_t... Bound>
+  static constexpr bool accepts() noexcept {
+    if constexpr (sizeof...(Bound) == sizeof...(Types)) {
+      return std::is_invocable_r_v<R, T, decltype(get<Bound>(std::declval<Types>()))...>;
+    } else {
+      return accepts_next<Bound...>(
+          std::make_index_sequence<variant_size_v<std::remove_reference_t<get_type_t<sizeof...(Bound), Types...>>>>());
+    }
+  }
+
+  template <size_t... Bound, size_t... Next>
+  static constexpr bool accepts_next(std::index_sequence<Next...>) noexcept {
+    return (accepts<Bound..., Next>() || ...);
+  }
+
+  [[noreturn]] static R reject(const size_t*, T, Types...) {
+    throw_bad_variant_access("visitor does not accept the held alternatives");
+  }
+
+  template <size_t... Bound>
+  static constexpr R dispatch(const size_t* indexes, T visitor, Types... vars) {
+    if constexpr (sizeof...(Bound) == sizeof...(Types)) {
+      return std::invoke(std::forward<T>(visitor), get<Bound>(std::forward<Types>(vars))...);
+    } else {
+      return table_v<Bound...>[indexes[sizeof...(Bound)]](indexes, std::forward<T>(visitor),
+                                                          std::forward<Types>(vars)...);
+    }
+  }
+
+  using entry_t = R (*)(const size_t*, T, Types...);
+
+  template <size_t... Bound>
+  static constexpr entry_t entry() noexcept {
+    if constexpr (accepts<Bound...>()) {
+      return &dispatch<Bound...>;
+    } else {
+      return &reject;
+    }
+  }
+
+  template <size_t... Bound, size_t... Next>
+  static constexpr auto make_table(std::index_sequence<Next...>) noexcept {
+    return std::array<entry_t, sizeof...(Next)>{entry<Bound..., Next>()...};
+  }
+
+  template <size_t... Bound>
+  static constexpr auto table_v = make_table<Bound...>(
+      std::make_index_sequence<variant_size_v<std::remove_reference_t<get_type_t<sizeof...(Bound), Types...>>>>());
+};
 } // namespace details
 
 template <typename T, typename... Types>
 constexpr decltype(auto) visit(T&& visitor, Types&&... vars) {
   if ((vars.valueless_by_exception() || ...)) {
-    throw bad_variant_access();
+    details::throw_bad_variant_access();
+  }
+  return details::in_impl(details::matrix_v<T&&, Types&&...>, vars.index()...)(std::forward<T>(visitor),
+                                                                               std::forward<Types>(vars)...);
+}
+
+// Like visit, but only the combinations of alternatives the visitor can be invoked with (and whose result converts
+// to R) are instantiated; holding any other combination fails like an access to the wrong alternative. It pays one
+// indirect call per variant, so it only reduces code size when the visitor rejects most combinations.
+template <typename R, typename T, typename... Types>
+constexpr R visit_sparse(T&& visitor, Types&&... vars) {
+  if ((vars.valueless_by_exception() || ...)) {
+    details::throw_bad_variant_access();
   }
-  return in_impl(details::matrix_v<T&&, Types&&...>, vars.index()...)(std::forward<T>(visitor),
-                                                                      std::forward<Types>(vars)...);
+  const size_t indexes[] = {vars.index()...};
+  return details::sparse_visit<R, T&&, Types&&...>::dispatch(indexes, std::forward<T>(visitor),
+                                                              std::forward<Types>(vars)...);
 }
+VARIANT_END_EXPORT
 
 #endif
@@ -0,0 +1,320 @@
+#ifndef VARIANT_VERSIONED_H
+#define VARIANT_VERSIONED_H
+
+#include "variant.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace details {
+inline uint64_t next_versioned_id() noexcept {
+  static std::atomic<uint64_t> last{0};
+  return last.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+} // namespace details
+
+// A variant that counts its mutations. Every emplace, assignment, swap and modify bumps version() and then calls the
+// subscribers with the new value; mutable get, get_if and visit bump the version too, but cannot notify after the
+// caller writes through the reference they return, so code that needs callbacks should mutate through modify.
+// Reading through a const versioned_variant never bumps the version.
+//
+// Copies take the value and version but not the subscribers. Every object, copies included, also gets an id() that is
+// unique in the process, so caches can tell it apart from an earlier object that lived at the same address.
+//
+// A subscriber that throws leaves the value changed and propagates out of the mutating call; the subscribers after it
+// are not called for that change.
+template <typename... Types>
+class versioned_variant {
+public:
+  using variant_type = variant<Types...>;
+  using callback = std::function<void(const variant_type&, uint64_t)>;
+
+  versioned_variant() requires std::is_default_constructible_v<variant_type> = default;
+
+  template <typename... Args>
+  explicit versioned_variant(in_place_t, Args&&... args) requires(std::is_constructible_v<variant_type, Args...>)
+      : value_(std::forward<Args>(args)...) {}
+
+  template <typename From>
+  versioned_variant(From&& f) // NOLINT(google-explicit-constructor)
+      requires(!std::is_same_v<std::remove_cvref_t<From>, versioned_variant> &&
+               std::is_constructible_v<variant_type, From>)
+      : value_(std::forward<From>(f)) {}
+
+  versioned_variant(const versioned_variant& other) : value_(other.value_), version_(other.version_) {}
+
+  versioned_variant(versioned_variant&& other) noexcept(std::is_nothrow_move_constructible_v<variant_type>)
+      : value_(std::move(other.value_)), version_(other.version_) {}
+
+  versioned_variant& operator=(const versioned_variant& other) {
+    value_ = other.value_;
+    changed();
+    return *this;
+  }
+
+  // Not noexcept even for nothrow alternatives: the subscribers run here and may throw.
+  versioned_variant& operator=(versioned_variant&& other) {
+    value_ = std::move(other.value_);
+    changed();
+    return *this;
+  }
+
+  template <typename From>
+  versioned_variant& operator=(From&& f) requires(!std::is_same_v<std::remove_cvref_t<From>, versioned_variant> &&
+                                                  std::is_assignable_v<variant_type&, From>) {
+    value_ = std::forward<From>(f);
+    changed();
+    return *this;
+  }
+
+  template <size_t Index, typename... Args>
+  variant_alternative_t<Index, variant_type>& emplace(Args&&... args) requires(
+      std::is_constructible_v<variant_alternative_t<Index, variant_type>, Args...>) {
+    auto& result = value_.template emplace<Index>(std::forward<Args>(args)...);
+    changed();
+    return result;
+  }
+
+  template <typename T, typename... Args, size_t Index = details::find_first_v<T, Types...>>
+  T& emplace(Args&&... args) requires(details::count_of_v<T, Types...> == 1 && std::is_constructible_v<T, Args...>) {
+    return emplace<Index>(std::forward<Args>(args)...);
+  }
+
+  void swap(versioned_variant& other) {
+    value_.swap(other.value_);
+    changed();
+    other.changed();
+  }
+
+  friend void swap(versioned_variant& a, versioned_variant& b) {
+    a.swap(b);
+  }
+
+  // Applies f to the value and counts it as a change, unless f returns false.
+  template <typename F>
+  decltype(auto) modify(F&& f) {
+    using result_t = std::invoke_result_t<F, variant_type&>;
+    if constexpr (std::is_void_v<result_t>) {
+      std::invoke(std::forward<F>(f), value_);
+      changed();
+    } else if constexpr (std::is_same_v<result_t, bool>) {
+      bool modified = std::invoke(std::forward<F>(f), value_);
+      if (modified) {
+        changed();
+      }
+      return modified;
+    } else {
+      decltype(auto) result = std::invoke(std::forward<F>(f), value_);
+      changed();
+      return result;
+    }
+  }
+
+  // Hands out the value for writing without a notification; the version is bumped up front.
+  variant_type& mutate() noexcept {
+    ++version_;
+    return value_;
+  }
+
+  const variant_type& operator*() const noexcept {
+    return value_;
+  }
+
+  const variant_type* operator->() const noexcept {
+    return std::addressof(value_);
+  }
+
+  uint64_t version() const noexcept {
+    return version_;
+  }
+
+  uint64_t id() const noexcept {
+    return id_;
+  }
+
+  bool changed_since(uint64_t seen) const noexcept {
+    return version_ != seen;
+  }
+
+  size_t index() const noexcept {
+    return value_.index();
+  }
+
+  bool valueless_by_exception() const noexcept {
+    return value_.valueless_by_exception();
+  }
+
+  // Returns an id for unsubscribe. Subscribers may not subscribe or unsubscribe from inside the callback.
+  size_t subscribe(callback f) {
+    subscribers_.emplace_back(++last_id_, std::move(f));
+    return last_id_;
+  }
+
+  bool unsubscribe(size_t id) {
+    for (auto it = subscribers_.begin(); it != subscribers_.end(); ++it) {
+      if (it->first == id) {
+        subscribers_.erase(it);
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  void changed() {
+    ++version_;
+    for (auto& [id, f] : subscribers_) {
+      f(value_, version_);
+    }
+  }
+
+  variant_type value_;
+  uint64_t version_ = 0;
+  uint64_t id_ = details::next_versioned_id();
+  size_t last_id_ = 0;
+  std::vector<std::pair<size_t, callback>> subscribers_;
+};
+
+// Derived data of one versioned_variant, recomputed only when the source has changed since the last computation. The
+// source is recognized by its id(), never by its address.
+template <typename T>
+class version_cache {
+public:
+  template <typename... Types, typename F>
+  const T& get(const versioned_variant<Types...>& source, F&& compute) {
+    if (!value_ || source_ != source.id() || source.changed_since(seen_)) {
+      value_.emplace(std::invoke(std::forward<F>(compute), *source));
+      source_ = source.id();
+      seen_ = source.version();
+    }
+    return *value_;
+  }
+
+  void invalidate() noexcept {
+    value_.reset();
+  }
+
+private:
+  std::optional<T> value_;
+  uint64_t source_ = 0;
+  uint64_t seen_ = 0;
+};
+
+template <typename... Types>
+struct variant_size<versioned_variant<Types...>> : details::pack_size<Types...> {};
+
+template <typename... Types>
+struct variant_size<const versioned_variant<Types...>> : details::pack_size<Types...> {};
+
+template <size_t Index, typename... Types>
+struct variant_alternative<Index, versioned_variant<Types...>> {
+  using type = details::get_type_t<Index, Types...>;
+};
+
+template <size_t Index, typename... Types>
+struct variant_alternative<Index, const versioned_variant<Types...>> {
+  using type = const details::get_type_t<Index, Types...>;
+};
+
+template <typename T, typename... Types>
+bool holds_alternative(const versioned_variant<Types...>& v) noexcept requires(details::count_of_v<T, Types...> == 1) {
+  return holds_alternative<T>(*v);
+}
+
+template <size_t Index, typename... Types>
+const details::get_type_t<Index, Types...>& get(const versioned_variant<Types...>& v) {
+  return get<Index>(*v);
+}
+
+template <size_t Index, typename... Types>
+details::get_type_t<Index, Types...>& get(versioned_variant<Types...>& v) {
+  if (Index != v.index()) {
+    details::throw_bad_variant_access();
+  }
+  return get<Index>(v.mutate());
+}
+
+template <size_t Index, typename... Types>
+details::get_type_t<Index, Types...>&& get(versioned_variant<Types...>&& v) {
+  return std::move(get<Index>(v));
+}
+
+template <size_t Index, typename... Types>
+const details::get_type_t<Index, Types...>&& get(const versioned_variant<Types...>&& v) {
+  return std::move(get<Index>(v));
+}
+
+template <typename T, typename... Types, size_t Index = details::find_first_v<T, Types...>>
+const T& get(const versioned_variant<Types...>& v) requires(details::count_of_v<T, Types...> == 1) {
+  return get<Index>(v);
+}
+
+template <typename T, typename... Types, size_t Index = details::find_first_v<T, Types...>>
+T& get(versioned_variant<Types...>& v) requires(details::count_of_v<T, Types...> == 1) {
+  return get<Index>(v);
+}
+
+template <typename T, typename... Types, size_t Index = details::find_first_v<T, Types...>>
+T&& get(versioned_variant<Types...>&& v) requires(details::count_of_v<T, Types...> == 1) {
+  return get<Index>(std::move(v));
+}
+
+template <typename T, typename... Types, size_t Index = details::find_first_v<T, Types...>>
+const T&& get(const versioned_variant<Types...>&& v) requires(details::count_of_v<T, Types...> == 1) {
+  return get<Index>(std::move(v));
+}
+
+template <size_t Index, typename... Types>
+std::add_pointer_t<const details::get_type_t<Index, Types...>> get_if(const versioned_variant<Types...>* v) noexcept {
+  return v != nullptr ? get_if<Index>(std::addressof(**v)) : nullptr;
+}
+
+template <size_t Index, typename... Types>
+std::add_pointer_t<details::get_type_t<Index, Types...>> get_if(versioned_variant<Types...>* v) noexcept {
+  return (v != nullptr && Index == v->index()) ? std::addressof(get<Index>(v->mutate())) : nullptr;
+}
+
+template <typename T, typename... Types, size_t Index = details::find_first_v<T, Types...>>
+std::add_pointer_t<const T> get_if(const versioned_variant<Types...>* v) noexcept {
+  return get_if<Index>(v);
+}
+
+template <typename T, typename... Types, size_t Index = details::find_first_v<T, Types...>>
+std::add_pointer_t<T> get_if(versioned_variant<Types...>* v) noexcept {
+  return get_if<Index>(v);
+}
+
+template <typename... Types>
+bool operator==(const versioned_variant<Types...>& a, const versioned_variant<Types...>& b) {
+  return *a == *b;
+}
+
+template <typename... Types>
+bool operator!=(const versioned_variant<Types...>& a, const versioned_variant<Types...>& b) {
+  return *a != *b;
+}
+
+template <typename... Types>
+bool operator<(const versioned_variant<Types...>& a, const versioned_variant<Types...>& b) {
+  return *a < *b;
+}
+
+template <typename... Types>
+bool operator>(const versioned_variant<Types...>& a, const versioned_variant<Types...>& b) {
+  return *a > *b;
+}
+
+template <typename... Types>
+bool operator<=(const versioned_variant<Types...>& a, const versioned_variant<Types...>& b) {
+  return *a <= *b;
+}
+
+template <typename... Types>
+bool operator>=(const versioned_variant<Types...>& a, const versioned_variant<Types...>& b) {
+  return *a >= *b;
+}
+
+#endif